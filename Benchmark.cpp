@@ -0,0 +1,441 @@
+﻿#include "Storages.hpp"
+#include "View.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+性能测试,覆盖 hbv, 组合位数组, storage, entities 和 for_view
+结果以 JSON 输出到标准输出(或 --out 指定的文件),进度输出到标准错误
+参数:
+	--min-size n  最小规模(默认 1K)
+	--max-size n  最大规模(默认 16M)
+	--min-time s  每项测试至少运行的秒数(默认 0.2)
+	--filter str  只运行名字包含 str 的测试
+	--out file    JSON 输出文件
+*/
+
+using namespace ecs;
+
+struct Location { float x, y, z; };
+struct Velocity { float x, y, z; };
+struct Mesh { int id; };
+
+namespace ecs
+{
+	using Locations = Component(Location, sparse_vector);
+	using Velocities = Component(Velocity, sparse_vector);
+}
+
+namespace bench
+{
+	using clock = std::chrono::steady_clock;
+
+	//一组测试用的下标,升序
+	struct pattern
+	{
+		const char* name;
+		double density;
+		index_t size;
+		std::vector<index_t> ids;
+		//ids 合并后的连续区间 [begin, end)
+		std::vector<std::pair<index_t, index_t>> ranges;
+	};
+
+	struct result
+	{
+		std::string name;
+		std::string pattern;
+		index_t size;
+		double density;
+		std::size_t ops;
+		std::size_t iterations;
+		double ns;
+	};
+
+	struct options
+	{
+		index_t minSize = 1u << 10;
+		index_t maxSize = 1u << 24;
+		double minTime = 0.2;
+		std::string filter;
+		const char* out = nullptr;
+	};
+
+	static constexpr std::size_t MaxIterations = 1000u;
+
+	options opts;
+	std::vector<result> results;
+	volatile std::uint64_t sink;
+
+	//random: 每个下标以 density 的概率出现
+	//clustered: 长度随机的连续段,段之间的空隙保证整体密度
+	pattern make_pattern(index_t size, double density, bool clustered, std::uint32_t seed)
+	{
+		pattern p{ clustered ? "clustered" : "random", density, size, {}, {} };
+		std::mt19937 rng(seed);
+		if (clustered)
+		{
+			std::uniform_real_distribution<double> jitter(0.5, 1.5);
+			index_t i = 0;
+			while (i < size)
+			{
+				index_t run = std::min(size - i, index_t(1u + rng() % 512u));
+				for (index_t j = i; j < i + run; ++j)
+					p.ids.push_back(j);
+				i += run;
+				if (density < 1.0)
+					i += index_t(run * (1.0 - density) / density * jitter(rng));
+			}
+		}
+		else
+		{
+			std::bernoulli_distribution pick(density);
+			for (index_t i = 0; i < size; ++i)
+				if (pick(rng))
+					p.ids.push_back(i);
+		}
+		for (index_t id : p.ids)
+		{
+			if (!p.ranges.empty() && p.ranges.back().second == id)
+				++p.ranges.back().second;
+			else
+				p.ranges.push_back({ id, id + 1u });
+		}
+		return p;
+	}
+
+	template<typename H = common::hbv>
+	H make_hbv(const pattern& p)
+	{
+		H vec(p.size);
+		for (auto& r : p.ranges)
+			vec.range_set(r.first, r.second, true);
+		return vec;
+	}
+
+	//重复执行直到累计时间超过 minTime, setup 不计时
+	template<typename S, typename F>
+	void run(const char* name, const pattern& p, std::size_t ops, S&& setup, F&& f)
+	{
+		if (!opts.filter.empty() && std::strstr(name, opts.filter.c_str()) == nullptr)
+			return;
+		double total = 0.0;
+		std::size_t iterations = 0u;
+		do
+		{
+			setup();
+			auto begin = clock::now();
+			f();
+			auto end = clock::now();
+			total += std::chrono::duration<double, std::nano>(end - begin).count();
+			++iterations;
+		} while (total < opts.minTime * 1e9 && iterations < MaxIterations);
+		results.push_back({ name, p.name, p.size, p.density, ops, iterations, total / iterations });
+		std::fprintf(stderr, "%-28s %-9s %9u %5.2f %14.1f ns %8.2f ns/op\n",
+			name, p.name, p.size, p.density, total / iterations, ops ? total / iterations / ops : 0.0);
+	}
+
+	template<typename F>
+	void run(const char* name, const pattern& p, std::size_t ops, F&& f)
+	{
+		run(name, p, ops, [] {}, std::forward<F>(f));
+	}
+
+	void hbv_ops(const pattern& p, const pattern& q)
+	{
+		const std::size_t n = p.ids.size();
+		common::hbv vec(p.size);
+		const common::hbv filled = make_hbv(p);
+		const common::hbv other = make_hbv(q);
+
+		run("hbv/set", p, n, [&] { vec = common::hbv(p.size); }, [&]
+		{
+			for (index_t id : p.ids)
+				vec.set(id, true);
+		});
+		common::atomic_hbv shared(p.size);
+		run("hbv/atomic_set", p, n, [&] { shared.clear(); }, [&]
+		{
+			common::job_pool::instance().parallel_for(0u, index_t(n), 4096u, [&](index_t begin, index_t end)
+			{
+				for (index_t i = begin; i < end; ++i)
+					shared.set(p.ids[i], true);
+			});
+		});
+		run("hbv/range_set", p, n, [&] { vec = common::hbv(p.size); }, [&]
+		{
+			for (auto& r : p.ranges)
+				vec.range_set(r.first, r.second, true);
+		});
+		run("hbv/reset", p, n, [&] { vec = filled; }, [&]
+		{
+			for (index_t id : p.ids)
+				vec.set(id, false);
+		});
+		run("hbv/range_reset", p, n, [&] { vec = filled; }, [&]
+		{
+			for (auto& r : p.ranges)
+				vec.range_set(r.first, r.second, false);
+		});
+		run("hbv/merge_add", p, n, [&] { vec = other; }, [&] { vec.merge_add(filled); });
+		run("hbv/merge_sub", p, n, [&] { vec = other; }, [&] { vec.merge_sub(filled); });
+		run("hbv/for_each", p, n, [&]
+		{
+			std::uint64_t sum = 0u;
+			common::for_each(filled, [&sum](index_t i) { sum += i; });
+			sink = sum;
+		});
+		run("hbv/for_each_run", p, n, [&]
+		{
+			std::uint64_t sum = 0u;
+			common::for_each_run(filled, [&sum](index_t b, index_t e) { sum += e - b; });
+			sink = sum;
+		});
+		run("hbv/for_each_word", p, n, [&]
+		{
+			std::uint64_t sum = 0u;
+			common::for_each_word(filled, [&sum](index_t b, common::hbv::flag_t m) { sum += b ^ m; });
+			sink = sum;
+		});
+		constexpr std::size_t Lookups = 1000u;
+		run("hbv/first_last", p, Lookups * 2u, [&]
+		{
+			std::uint64_t sum = 0u;
+			for (std::size_t i = 0; i < Lookups; ++i)
+				sum += common::first(filled) + common::last(filled);
+			sink = sum;
+		});
+	}
+
+	void composite_ops(const pattern& p, const pattern& q)
+	{
+		const std::size_t n = p.ids.size();
+		const common::hbv a = make_hbv(p);
+		const common::hbv b = make_hbv(q);
+		auto traverse = [](const auto& vec)
+		{
+			std::uint64_t sum = 0u;
+			common::for_each(vec, [&sum](index_t i) { sum += i; });
+			sink = sum;
+		};
+		run("composite/and", p, n, [&] { traverse(common::and_(a, b)); });
+		run("composite/or", p, n, [&] { traverse(common::or_(a, b)); });
+		run("composite/and_not", p, n, [&] { traverse(common::and_(a, common::not_(b))); });
+		run("composite/andnot", p, n, [&] { traverse(common::andnot(a, b)); });
+	}
+
+	template<template<typename> class C, typename T, typename V>
+	void storage_ops(const char* (&names)[4], const pattern& p, const V& value)
+	{
+		using storage = components<T, C>;
+		const std::size_t n = p.ids.size();
+		const entity_hbv all = make_hbv<entity_hbv>(p);
+		std::unique_ptr<storage> s;
+		auto fresh = [&] { s.reset(); s = std::make_unique<storage>(); };
+		auto filled = [&]
+		{
+			fresh();
+			for (auto& r : p.ranges)
+				s->batch_create(r.first, r.second, value(r.first));
+		};
+
+		run(names[0], p, n, fresh, [&]
+		{
+			for (index_t id : p.ids)
+				s->create(id, value(id));
+		});
+		run(names[1], p, n, filled, [&]
+		{
+			for (index_t id : p.ids)
+				s->remove(id);
+		});
+		run(names[2], p, n, fresh, [&]
+		{
+			for (auto& r : p.ranges)
+				s->batch_create(r.first, r.second, value(r.first));
+		});
+		run(names[3], p, n, filled, [&] { s->batch_remove(all); });
+		s.reset();
+	}
+
+	void entities_ops(const pattern& p)
+	{
+		//先创建 size 个 entity, 然后按 pattern 杀死并重新创建
+		const std::size_t n = p.ids.size();
+		std::unique_ptr<entities> ents;
+		if (p.density == 1.0)
+		{
+			run("entities/create", p, p.size, [&] { ents = std::make_unique<entities>(); }, [&]
+			{
+				for (index_t i = 0; i < p.size; ++i)
+					ents->create();
+			});
+		}
+		run("entities/churn", p, n * 2u, [&]
+		{
+			ents = std::make_unique<entities>();
+			for (index_t i = 0; i < p.size; ++i)
+				ents->create();
+		}, [&]
+		{
+			for (index_t id : p.ids)
+				ents->kill(ents->get(id));
+			ents->die();
+			for (std::size_t i = 0; i < n; ++i)
+				ents->create();
+		});
+		run("entities/batch_allocate", p, n * 2u, [&]
+		{
+			ents = std::make_unique<entities>();
+			ents->batch_create(p.size);
+		}, [&]
+		{
+			for (index_t id : p.ids)
+				ents->kill(ents->get(id));
+			ents->die();
+			ents->batch_allocate(index_t(n));
+		});
+		ents.reset();
+	}
+
+	void view_ops(const pattern& p)
+	{
+		const std::size_t n = p.ids.size();
+		Locations locs;
+		Velocities vels;
+		for (auto& r : p.ranges)
+		{
+			locs.batch_create(r.first, r.second, { 0.f, 0.f, 0.f });
+			vels.batch_create(r.first, r.second, { 1.f, 2.f, 3.f });
+		}
+		auto view = as_view(locs, vels);
+		auto job = [](Location& loc, const Velocity& vel)
+		{
+			loc.x += vel.x; loc.y += vel.y; loc.z += vel.z;
+		};
+		run("view/seq", p, n, [&] { for_view<seq>(view, job); });
+		run("view/par", p, n, [&] { for_view<par>(view, job); });
+		run("view/auto_par", p, n, [&] { for_view<auto_par>(view, job); });
+		run("view/runs", p, n, [&]
+		{
+			for_view<runs>(view, [](span<Location> loc, span<const Velocity> vel)
+			{
+				for (index_t i = 0; i < loc.size; ++i)
+				{
+					loc[i].x += vel[i].x; loc[i].y += vel[i].y; loc[i].z += vel[i].z;
+				}
+			});
+		});
+		run("view/chunks", p, n, [&]
+		{
+			for_view<chunks>(view, [](chunk<Location> loc, chunk<const Velocity> vel)
+			{
+				for (index_t i = 0; i < chunk<Location>::Size; ++i)
+					if (loc.contain(i))
+					{
+						loc[i].x += vel[i].x; loc[i].y += vel[i].y; loc[i].z += vel[i].z;
+					}
+			});
+		});
+	}
+
+	void run_all()
+	{
+		static const char* sparse[4] = { "sparse_vector/create", "sparse_vector/remove", "sparse_vector/batch_create", "sparse_vector/batch_remove" };
+		static const char* dense[4] = { "dense_vector/create", "dense_vector/remove", "dense_vector/batch_create", "dense_vector/batch_remove" };
+		static const char* unique[4] = { "unique_vector/create", "unique_vector/remove", "unique_vector/batch_create", "unique_vector/batch_remove" };
+		const std::shared_ptr<Mesh> meshes[4] = { std::make_shared<Mesh>(Mesh{ 0 }), std::make_shared<Mesh>(Mesh{ 1 }), std::make_shared<Mesh>(Mesh{ 2 }), std::make_shared<Mesh>(Mesh{ 3 }) };
+
+		for (index_t size : { 1u << 10, 1u << 16, 1u << 20, 1u << 24 })
+		{
+			if (size < opts.minSize || size > opts.maxSize || size > common::hbv::config::MaxSize)
+				continue;
+			for (double density : { 0.01, 0.5, 1.0 })
+			{
+				for (bool clustered : { false, true })
+				{
+					//满的情况两种分布相同
+					if (density == 1.0 && clustered)
+						continue;
+					const pattern p = make_pattern(size, density, clustered, 1u);
+					const pattern q = make_pattern(size, density, clustered, 2u);
+					hbv_ops(p, q);
+					composite_ops(p, q);
+					storage_ops<sparse_vector, Location>(sparse, p, [](index_t i) { return Location{ float(i), 0.f, 0.f }; });
+					storage_ops<dense_vector, Location>(dense, p, [](index_t i) { return Location{ float(i), 0.f, 0.f }; });
+					storage_ops<unique_vector, std::shared_ptr<Mesh>>(unique, p, [&meshes](index_t i) { return meshes[i % 4u]; });
+					view_ops(p);
+					if (!clustered)
+						entities_ops(p);
+				}
+			}
+		}
+	}
+
+	void write_json(std::FILE* file)
+	{
+		std::fprintf(file, "{\n  \"context\": {\n");
+#if defined(_MSC_VER)
+		std::fprintf(file, "    \"compiler\": \"msvc %d\",\n", _MSC_FULL_VER);
+#elif defined(__VERSION__)
+		std::fprintf(file, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+#if defined(HBV_USE_BMI)
+		std::fprintf(file, "    \"bmi\": true,\n");
+#else
+		std::fprintf(file, "    \"bmi\": false,\n");
+#endif
+		std::fprintf(file, "    \"entity_bits\": %u,\n", unsigned(sizeof(ecs::entity) * 8u));
+		std::fprintf(file, "    \"threads\": %u,\n", std::thread::hardware_concurrency());
+		std::fprintf(file, "    \"min_time\": %g\n  },\n  \"benchmarks\": [\n", opts.minTime);
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const result& r = results[i];
+			std::fprintf(file,
+				"    {\"name\": \"%s\", \"pattern\": \"%s\", \"size\": %u, \"density\": %g, \"ops\": %zu, \"iterations\": %zu, \"ns\": %.1f, \"ns_per_op\": %.3f}%s\n",
+				r.name.c_str(), r.pattern.c_str(), r.size, r.density, r.ops, r.iterations, r.ns,
+				r.ops ? r.ns / r.ops : 0.0, i + 1 == results.size() ? "" : ",");
+		}
+		std::fprintf(file, "  ]\n}\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace bench;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::strcmp(argv[i], "--min-size") == 0)
+			opts.minSize = (index_t)std::strtoul(argv[i + 1], nullptr, 10);
+		else if (std::strcmp(argv[i], "--max-size") == 0)
+			opts.maxSize = (index_t)std::strtoul(argv[i + 1], nullptr, 10);
+		else if (std::strcmp(argv[i], "--min-time") == 0)
+			opts.minTime = std::strtod(argv[i + 1], nullptr);
+		else if (std::strcmp(argv[i], "--filter") == 0)
+			opts.filter = argv[i + 1];
+		else if (std::strcmp(argv[i], "--out") == 0)
+			opts.out = argv[i + 1];
+		else
+		{
+			std::fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	run_all();
+	std::FILE* file = opts.out ? std::fopen(opts.out, "w") : stdout;
+	if (file == nullptr)
+	{
+		std::fprintf(stderr, "can't open %s\n", opts.out);
+		return 1;
+	}
+	write_json(file);
+	if (file != stdout)
+		std::fclose(file);
+	return 0;
+}
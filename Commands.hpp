@@ -0,0 +1,340 @@
+﻿#pragma once
+#include "Entities.hpp"
+#include "Components.hpp"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecs
+{
+	namespace command_detail
+	{
+		//最高位标记尚未创建的 entity,低位为其在缓冲区中的序号
+		constexpr index_t PendingBit = 1u << 31;
+
+		//尚未创建的 entity 的全局序号(按缓冲区依次编号)到实际 id 的映射
+		struct spawn_map
+		{
+			id_ranges ranges;
+			//每个区间第一个 entity 的序号
+			std::vector<index_t> starts;
+
+			explicit spawn_map(id_ranges allocated) : ranges(std::move(allocated))
+			{
+				index_t start = 0u;
+				for (const auto& range : ranges)
+				{
+					starts.push_back(start);
+					start += range.second - range.first;
+				}
+			}
+
+			index_t operator()(index_t k) const noexcept
+			{
+				std::size_t i = std::upper_bound(starts.begin(), starts.end(), k) - starts.begin() - 1u;
+				return ranges[i].first + (k - starts[i]);
+			}
+		};
+
+		//同一个 components 上记录的命令,按 components 的地址区分
+		struct component_commands_abstract
+		{
+			virtual ~component_commands_abstract() {}
+			//把命令追加到 to 中,本缓冲区尚未创建的 entity 的全局序号从 spawnBase 开始
+			virtual void append_to(component_commands_abstract& to, const spawn_map& spawns, index_t spawnBase) const = 0;
+			virtual void apply() = 0;
+			virtual void clear() noexcept = 0;
+			//同类型的空命令集合,用于汇总
+			virtual std::unique_ptr<component_commands_abstract> make_empty() const = 0;
+		};
+
+		template<typename Cs>
+		class component_commands final : public component_commands_abstract
+		{
+			using T = typename Cs::type;
+			Cs& _components;
+			std::vector<std::pair<index_t, T>> _added;
+			std::vector<index_t> _removed;
+
+			static index_t resolve(index_t id, const spawn_map& spawns, index_t spawnBase) noexcept
+			{
+				return (id & PendingBit) ? spawns(spawnBase + (id & ~PendingBit)) : id;
+			}
+
+			void apply_added()
+			{
+				//按 entity 排序,同一个 entity 保留最后一次添加
+				std::stable_sort(_added.begin(), _added.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+				auto last = std::unique(_added.rbegin(), _added.rend(), [](const auto& a, const auto& b) { return a.first == b.first; });
+				_added.erase(_added.begin(), last.base());
+				std::vector<T> values;
+				std::size_t i = 0;
+				while (i < _added.size())
+				{
+					index_t begin = _added[i].first;
+					if (_components.contain(begin))
+					{
+						_components.create(begin, _added[i].second);
+						++i;
+						continue;
+					}
+					//连续且尚无 component 的一段批量创建
+					values.clear();
+					index_t end = begin;
+					while (i < _added.size() && _added[i].first == end && !_components.contain(end))
+					{
+						values.push_back(std::move(_added[i].second));
+						++end, ++i;
+					}
+					_components.batch_create_from(begin, end, values.data());
+				}
+			}
+
+			void apply_removed()
+			{
+				index_t size = _components.filter().size();
+				entity_hbv remove(size);
+				bool any = false;
+				for (index_t id : _removed)
+					if (id < size && _components.contain(id))
+					{
+						remove.set(id, true);
+						any = true;
+					}
+				if (any)
+					_components.batch_remove(remove);
+			}
+
+		public:
+			explicit component_commands(Cs& components) noexcept : _components(components) {}
+
+			void add(index_t id, const T& value)
+			{
+				_added.emplace_back(id, value);
+			}
+
+			void remove(index_t id)
+			{
+				_removed.push_back(id);
+			}
+
+			void append_to(component_commands_abstract& to, const spawn_map& spawns, index_t spawnBase) const override
+			{
+				auto& target = static_cast<component_commands&>(to);
+				for (const auto& command : _added)
+					target._added.emplace_back(resolve(command.first, spawns, spawnBase), command.second);
+				for (index_t id : _removed)
+					target._removed.push_back(resolve(id, spawns, spawnBase));
+			}
+
+			//先添加后删除,同一次回放中对同一个 entity 的删除会覆盖添加
+			void apply() override
+			{
+				apply_added();
+				apply_removed();
+			}
+
+			void clear() noexcept override
+			{
+				_added.clear();
+				_removed.clear();
+			}
+
+			std::unique_ptr<component_commands_abstract> make_empty() const override
+			{
+				return std::make_unique<component_commands>(_components);
+			}
+		};
+
+		struct component_slot
+		{
+			const void* key;
+			std::unique_ptr<component_commands_abstract> commands;
+		};
+
+		template<typename Cs>
+		component_commands<Cs>& find_or_add(std::vector<component_slot>& slots, Cs& components)
+		{
+			for (auto& slot : slots)
+				if (slot.key == &components)
+					return static_cast<component_commands<Cs>&>(*slot.commands);
+			slots.push_back({ &components, std::make_unique<component_commands<Cs>>(components) });
+			return static_cast<component_commands<Cs>&>(*slots.back().commands);
+		}
+
+		/*
+		尚未创建的 entity,只能在记录它的缓冲区中使用
+		回放时同一批创建的 entity 按空洞分段分配连续的 id
+		*/
+		struct deferred_entity
+		{
+			index_t index;
+		};
+
+		/*
+		单个线程的命令缓冲区,记录创建/销毁 entity 和添加/删除 component
+		只由所属的线程写入,不需要同步
+		*/
+		class command_buffer
+		{
+			friend class commands;
+			std::thread::id _owner = std::this_thread::get_id();
+			index_t _spawned = 0u;
+			std::vector<index_t> _destroyed;
+			std::vector<component_slot> _components;
+
+			template<typename Cs>
+			component_commands<Cs>& commands_of(Cs& components)
+			{
+				return find_or_add(_components, components);
+			}
+
+		public:
+			deferred_entity spawn() noexcept
+			{
+				return { _spawned++ };
+			}
+
+			void destroy(entity e)
+			{
+				_destroyed.push_back(e.id);
+				_destroyed.push_back(e.gen);
+			}
+
+			void destroy(deferred_entity e)
+			{
+				_destroyed.push_back(e.index | PendingBit);
+				_destroyed.push_back(0u);
+			}
+
+			template<typename Cs>
+			void add(Cs& components, index_t e, const typename Cs::type& value)
+			{
+				commands_of(components).add(e, value);
+			}
+
+			template<typename Cs>
+			void add(Cs& components, deferred_entity e, const typename Cs::type& value)
+			{
+				commands_of(components).add(e.index | PendingBit, value);
+			}
+
+			template<typename Cs>
+			void remove(Cs& components, index_t e)
+			{
+				commands_of(components).remove(e);
+			}
+
+			template<typename Cs>
+			void remove(Cs& components, deferred_entity e)
+			{
+				commands_of(components).remove(e.index | PendingBit);
+			}
+		};
+
+		/*
+		延迟的结构修改,用于在并行的 job 中创建/销毁 entity 和添加/删除 component
+		每个线程通过 local() 取得自己的缓冲区记录命令,并行阶段结束后由一个线程调用 playback 统一执行:
+		所有缓冲区创建的 entity 通过一次 batch_allocate 分配,优先填充已释放的 id,每段空洞内是连续的,
+		component 的命令按 entity 排序后,连续的一段用 batch_create_from 批量创建,删除合并为一个 hbv 后 batch_remove,
+		销毁的 entity 进入 killed 状态,由 entities::die 生效
+		*/
+		class commands
+		{
+			std::mutex _lock;
+			std::deque<command_buffer> _buffers;
+			const std::uint64_t _id;
+
+			static std::uint64_t next_id() noexcept
+			{
+				static std::atomic<std::uint64_t> counter{ 0u };
+				return ++counter;
+			}
+
+		public:
+			commands() noexcept : _id(next_id()) {}
+			commands(const commands&) = delete;
+			commands& operator=(const commands&) = delete;
+
+			//当前线程的缓冲区,第一次调用时注册
+			command_buffer& local()
+			{
+				struct cache
+				{
+					std::uint64_t owner;
+					command_buffer* buffer;
+				};
+				static thread_local cache last{ 0u, nullptr };
+				if (last.owner != _id)
+				{
+					//同一个线程交替使用多个 commands 时,找回之前注册的缓冲区
+					std::lock_guard<std::mutex> guard(_lock);
+					auto self = std::this_thread::get_id();
+					auto it = std::find_if(_buffers.begin(), _buffers.end(), [self](const command_buffer& b) { return b._owner == self; });
+					if (it == _buffers.end())
+					{
+						_buffers.emplace_back();
+						it = _buffers.end() - 1;
+					}
+					last = { _id, &*it };
+				}
+				return *last.buffer;
+			}
+
+			//执行并清空所有缓冲区中的命令,不能与 local() 的使用同时进行
+			void playback(entities& ents)
+			{
+				index_t spawned = 0u;
+				for (auto& buffer : _buffers)
+					spawned += buffer._spawned;
+				//优先填充已释放的 id
+				spawn_map spawns(ents.batch_allocate(spawned));
+
+				//按 components 汇总,尚未创建的 entity 换算为实际的 id
+				std::vector<component_slot> merged;
+				index_t base = 0u;
+				for (auto& buffer : _buffers)
+				{
+					for (auto& slot : buffer._components)
+					{
+						auto it = std::find_if(merged.begin(), merged.end(), [&slot](const component_slot& m) { return m.key == slot.key; });
+						if (it == merged.end())
+						{
+							merged.push_back({ slot.key, slot.commands->make_empty() });
+							it = merged.end() - 1;
+						}
+						slot.commands->append_to(*it->commands, spawns, base);
+						slot.commands->clear();
+					}
+					base += buffer._spawned;
+				}
+				for (auto& slot : merged)
+					slot.commands->apply();
+
+				base = 0u;
+				for (auto& buffer : _buffers)
+				{
+					for (std::size_t i = 0; i < buffer._destroyed.size(); i += 2)
+					{
+						index_t id = buffer._destroyed[i];
+						entity e = (id & PendingBit) ? ents.get(spawns(base + (id & ~PendingBit))) : entity{ id, buffer._destroyed[i + 1] };
+						//重复销毁只生效一次
+						if (ents.alive(e) && !ents.killed().test(e.id))
+							ents.kill(e);
+					}
+					buffer._destroyed.clear();
+					base += buffer._spawned;
+					buffer._spawned = 0u;
+				}
+			}
+		};
+	}
+
+	using command_detail::deferred_entity;
+	using command_detail::command_buffer;
+	using command_detail::commands;
+}
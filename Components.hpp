@@ -1,13 +1,19 @@
 #pragma once
 #include "HBV.hpp"
 #include "MPL.hpp"
+#include "Entities.hpp"
+#include <deque>
+#include <mutex>
+#include <vector>
 
 namespace ecs
 {
 	using index_t = common::index_t;
+	//storage ¼дʱʹõİ汾
+	using version_t = std::uint32_t;
 	namespace component_detail
 	{
-		using and_chbv = decltype(common::and(common::hbv{}, common::hbv{}));
+		using and_chbv = decltype(common::and_(entity_hbv{}, entity_hbv{}));
 
 		//ϸ,ṩӿ,ṩ
 		struct components_abstract
@@ -16,24 +22,212 @@ namespace ecs
 			virtual void remove(index_t e) = 0;
 			virtual void instantiate(index_t e, index_t proto) = 0;
 			virtual void batch_instantiate(index_t begin, index_t end, index_t proto) = 0;
-			virtual void batch_remove(const common::hbv& remove) = 0;
+			virtual void batch_remove(const entity_hbv& remove) = 0;
+			// entities::compact ıű±, component  id ҪڱЧ
+			virtual void remap(const id_remap& table) = 0;
+			//ӵ component  entity( filter ״̬Ӱ)
+			virtual const entity_hbv& members() const noexcept = 0;
 			virtual ~components_abstract() {}
 		};
 
+		//仯(һ system) components еλ, components::watch_changes ȡ
+		struct change_cursor
+		{
+			index_t slot;
+		};
+
+		/*
+		μ¼ component ı仯,ÿԼˮλ,ÿα仯ÿֻһ
+		дǼ¼һ(򿪵Ķ),߶ȡʱرշǿյĴ򿪶,ϲˮλ֮жβǰˮλ
+		߶ѶĶλᱻͷ;¼Ͷȡ,ڲе system ֮ʹ
+		*/
+		class change_tracker
+		{
+			mutable std::mutex _lock;
+			bool _enabled = false;
+			//_epochs[i] ıΪ _base + i
+			std::deque<entity_hbv> _epochs;
+			index_t _base = 0u;
+			//ÿһҪĶεı,InvalidId ʾͷ
+			std::vector<index_t> _cursors;
+
+			index_t open_epoch() const noexcept
+			{
+				return _base + index_t(_epochs.size()) - 1u;
+			}
+
+			void trim()
+			{
+				index_t oldest = open_epoch();
+				for (index_t cursor : _cursors)
+					if (cursor != InvalidId)
+						oldest = std::min(oldest, cursor);
+				while (_base < oldest)
+				{
+					_epochs.pop_front();
+					++_base;
+				}
+			}
+
+		public:
+			bool enabled() const noexcept
+			{
+				return _enabled;
+			}
+
+			void enable(bool value)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				_enabled = value;
+				if (value && _epochs.empty())
+					_epochs.emplace_back();
+				if (!value && !_epochs.empty())
+				{
+					//رǰĶβٿɶ,¿ż
+					_base = open_epoch() + 1u;
+					_epochs.clear();
+				}
+			}
+
+			template<typename F>
+			void mark(const F& filter)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				if (_enabled)
+					_epochs.back().merge_add(filter);
+			}
+
+			void mark(index_t e)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				if (_enabled)
+					_epochs.back().set(e, true);
+			}
+
+			//µߴһα仯ʼȡ,Ѿ¼ڴ򿪵Ķеı仯
+			change_cursor watch()
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				if (!_epochs.empty() && !common::empty(_epochs.back()))
+					_epochs.emplace_back();
+				index_t position = _epochs.empty() ? _base : open_epoch();
+				auto it = std::find(_cursors.begin(), _cursors.end(), InvalidId);
+				if (it == _cursors.end())
+					it = _cursors.insert(it, InvalidId);
+				*it = position;
+				//ûʱչرյĶβҪ
+				if (!_epochs.empty())
+					trim();
+				return { index_t(it - _cursors.begin()) };
+			}
+
+			void unwatch(change_cursor cursor)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				_cursors[cursor.slot] = InvalidId;
+				if (!_epochs.empty())
+					trim();
+			}
+
+			//ˮλ֮ı仯ϲ out ,ǰˮλ
+			void collect(change_cursor cursor, entity_hbv& out)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				if (!_enabled)
+					return;
+				if (!common::empty(_epochs.back()))
+					_epochs.emplace_back();
+				index_t& position = _cursors[cursor.slot];
+				for (index_t e = std::max(position, _base); e < open_epoch(); ++e)
+					out.merge_add(_epochs[e - _base]);
+				position = open_epoch();
+				trim();
+			}
+
+			//ű±ж,ֻ live е id
+			void remap(const entity_hbv& live, const id_remap& table)
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				for (auto& epoch : _epochs)
+				{
+					entity_hbv kept(live.size());
+					kept.merge_add(common::and_(epoch, live));
+					epoch = remapped(kept, table);
+				}
+			}
+		};
+
 		//Ϸ,ṩʵ
 		template<template<typename> class C, typename T>
 		class components_generic : public components_abstract
 		{
 		protected:
-			common::hbv _has;
+			entity_hbv _has;
+			mutable change_tracker _changes;
+			///ɾ¼(ѡ),[0] Ϊ֡¼,[1] Ϊһ֡
+			bool _recordEvents = false;
+			entity_hbv _added[2];
+			entity_hbv _removed[2];
 			
 			//ڲӵĬʵֵĿѡӿ
-			template<typename T>
-			using batch_create_trait = decltype(&T::batch_create);
-			template<typename T>
-			using batch_remove_trait = decltype(&T::batch_remove);
-			template<typename T>
-			using instantiate_trait = decltype(&T::instantiate);
+			template<typename U>
+			using batch_create_trait = decltype(&U::batch_create);
+			template<typename U>
+			using batch_remove_trait = decltype(&U::batch_remove);
+			template<typename U>
+			using instantiate_trait = decltype(&U::instantiate);
+			template<typename U>
+			using batch_instantiate_trait = decltype(&U::batch_instantiate);
+			template<typename U>
+			using remap_trait = decltype(&U::remap);
+			template<typename U>
+			using after_batch_remove_trait = decltype(&U::after_batch_remove);
+			template<typename U>
+			using config_trait = typename U::config;
+			template<typename U>
+			using ranged_data_trait = decltype(std::declval<U&>().data(index_t(), index_t()));
+
+			//֤ _has  [0, end)
+			void reserve(index_t end) noexcept
+			{
+				if (end > _has.size())
+					_has.grow_to(std::max(end, _has.size() / 2u + _has.size()));
+			}
+
+			//¼λ _has 
+			void record_added(index_t e)
+			{
+				if (_recordEvents)
+				{
+					_added[0].grow_to(_has.size());
+					_added[0].set(e, true);
+				}
+			}
+
+			void record_added(index_t begin, index_t end)
+			{
+				if (_recordEvents)
+				{
+					_added[0].grow_to(_has.size());
+					_added[0].range_set(begin, end, true);
+				}
+			}
+
+			//֡Ӻɾ entity ٱ,Ȼɾ
+			template<typename F>
+			void record_removed(const F& remove)
+			{
+				if (_recordEvents)
+				{
+					_removed[0].merge_add(remove);
+					_added[0].merge_sub(remove);
+				}
+			}
+
+			//Ҫ֪Щ entity ӵ component ʱ( sparse_vector ͷſͰ), _has 
+			struct with_members_t {};
+			template<typename... Ts>
+			components_generic(with_members_t, Ts&&... args) : container(_has, std::forward<Ts>(args)...) {}
 
 		public:
 
@@ -41,17 +235,128 @@ namespace ecs
 			components_generic(Ts&&... args) noexcept : container(std::forward<Ts>(args)...) {}
 			~components_generic() noexcept
 			{
-				batch_remove(_has);
+				//ֻԪ,_has һͷ
+				destroy(_has);
 			}
 
 			C<T> container;
 			using type  = T;
-			template<typename T>
-			using storage = C<T>;
+			template<typename U>
+			using storage = C<U>;
 
 			decltype(auto) filter() const noexcept
 			{
-				return (const common::hbv&)_has;
+				return (const entity_hbv&)_has;
+			}
+
+			const entity_hbv& members() const noexcept override
+			{
+				return _has;
+			}
+
+			/*
+			仯׷(ѡ), for_view Կдķʽ(T&span<T>chunk<T>)ʱ,ѱ filter Ϊ仯
+			job ޸˿д֮ component ʱֶ mark_changed
+			ͨ watch_changes ȡˮλ, changed<T> ֻϴζȡ֮仯 entity
+			*/
+			void track_changes(bool enable = true)
+			{
+				_changes.enable(enable);
+			}
+
+			bool tracking_changes() const noexcept
+			{
+				return _changes.enabled();
+			}
+
+			//filter Ϊλλ, id 
+			template<typename F, typename = std::enable_if_t<common::is_detected<config_trait, F>::value>>
+			void mark_changed(const F& filter)
+			{
+				_changes.mark(filter);
+			}
+
+			void mark_changed(index_t e)
+			{
+				_changes.mark(e);
+			}
+
+			/*
+			/ɾ¼(ѡ), create/instantiate/batch_create ¼,remove/batch_remove ¼ɾ
+			flip_events ÿ֡һ,ѱ֡¼¼Ϊ added/removed ʼµһ֡
+			ȡһ֡¼,ͬһ֡ڵ system ¼ִ˳޹
+			*/
+			void track_events(bool enable = true)
+			{
+				_recordEvents = enable;
+				if (!enable)
+					clear_events();
+			}
+
+			bool tracking_events() const noexcept
+			{
+				return _recordEvents;
+			}
+
+			void flip_events()
+			{
+				std::swap(_added[0], _added[1]);
+				std::swap(_removed[0], _removed[1]);
+				_added[0].clear();
+				_removed[0].clear();
+			}
+
+			void clear_events()
+			{
+				for (index_t i = 0; i < 2u; ++i)
+				{
+					_added[i].clear();
+					_removed[i].clear();
+				}
+			}
+
+			//һ֡ӵ entity,Ѿɾ,ʱӦ filter 
+			const entity_hbv& added() const noexcept
+			{
+				return _added[1];
+			}
+
+			//һ֡ɾ entity
+			const entity_hbv& removed() const noexcept
+			{
+				return _removed[1];
+			}
+
+			change_cursor watch_changes()
+			{
+				return _changes.watch();
+			}
+
+			void unwatch_changes(change_cursor cursor)
+			{
+				_changes.unwatch(cursor);
+			}
+
+			//ȡ޸ component,ֻǰߵˮλ,ֻ view ҲԶȡ
+			void collect_changes(change_cursor cursor, entity_hbv& out) const
+			{
+				_changes.collect(cursor, out);
+			}
+
+			//¼д汾 storage( sparse_vector)ſ
+			version_t version() const noexcept
+			{
+				return container.version();
+			}
+
+			version_t next_version() noexcept
+			{
+				return container.next_version();
+			}
+
+			decltype(auto) changed_since(version_t since) const noexcept
+			{
+				return container.changed_since(since);
 			}
 
 			decltype(auto) get(index_t e) noexcept
@@ -64,15 +369,50 @@ namespace ecs
 				return container.get(e);
 			}
 
+			//ŵ storage(ṩ ChunkSize)ſ
+			decltype(auto) data(index_t e) noexcept
+			{
+				return container.data(e);
+			}
+
+			decltype(auto) data(index_t e) const noexcept
+			{
+				return container.data(e);
+			}
+
+			//ֻд [e, e + count),¼д汾 storage ֻһ
+			decltype(auto) data(index_t e, index_t count) noexcept
+			{
+				if constexpr(common::is_detected<ranged_data_trait, C<T>>::value)
+					return container.data(e, count);
+				else
+					return container.data(e);
+			}
+
+			//storage ͨ _has жͰǷΪ,˴ǰȱ,ɾǰ
 			decltype(auto) create(index_t e, const T& arg)  noexcept
 			{
 				if (contain(e))
 					container.remove(e);
+				else
+				{
+					reserve(e + 1u);
+					_has.set(e, true);
+					record_added(e);
+				}
 				return container.create(e, arg);
 			}
 
 			void instantiate(index_t e, index_t proto) noexcept
 			{
+				if (contain(e))
+					container.remove(e);
+				else
+				{
+					reserve(e + 1u);
+					_has.set(e, true);
+					record_added(e);
+				}
 				if constexpr(common::is_detected<instantiate_trait, C<T>>::value)
 					container.instantiate(e, proto);
 				else
@@ -86,12 +426,27 @@ namespace ecs
 
 			void remove(index_t e) noexcept
 			{
+				if (!contain(e))
+					return;
+				_has.set(e, false);
+				if (_recordEvents)
+				{
+					_removed[0].grow_to(_has.size());
+					_removed[0].set(e, true);
+					if (e < _added[0].size())
+						_added[0].set(e, false);
+				}
 				container.remove(e);
 			}
 
-			//һ
+			//һ,ڲӦ component
 			void batch_create(index_t begin, index_t end, const T& arg) noexcept
 			{
+				if (begin >= end)
+					return;
+				reserve(end);
+				_has.range_set(begin, end, true);
+				record_added(begin, end);
 				if constexpr(common::is_detected<batch_create_trait, C<T>>::value)
 				{
 					container.batch_create(begin, end, arg);
@@ -103,17 +458,115 @@ namespace ecs
 				}
 			}
 
+			//һ( entities::batch_allocate Ľ)
+			void batch_create(const id_ranges& ranges, const T& arg) noexcept
+			{
+				if (!ranges.empty())
+					reserve(ranges.back().second);
+				for (const auto& range : ranges)
+					batch_create(range.first, range.second, arg);
+			}
+
+			//һ,ÿԪʹøԵֵ(i Ӧ args[i - begin]),ڲӦ component
+			void batch_create_from(index_t begin, index_t end, const T* args) noexcept
+			{
+				if (begin >= end)
+					return;
+				reserve(end);
+				_has.range_set(begin, end, true);
+				record_added(begin, end);
+				for (index_t i = begin; i < end; ++i)
+					container.create(i, args[i - begin]);
+			}
+
 			void batch_instantiate(index_t begin, index_t end, index_t proto) noexcept
 			{
-				const T& prototype = container.get(proto);
-				batch_create(begin, end, prototype);
+				if constexpr(common::is_detected<batch_instantiate_trait, C<T>>::value)
+				{
+					if (begin >= end)
+						return;
+					reserve(end);
+					_has.range_set(begin, end, true);
+					record_added(begin, end);
+					container.batch_instantiate(begin, end, proto);
+				}
+				else
+				{
+					const T& prototype = container.get(proto);
+					batch_create(begin, end, prototype);
+				}
+			}
+
+			void batch_instantiate(const id_ranges& ranges, index_t proto) noexcept
+			{
+				if (!ranges.empty())
+					reserve(ranges.back().second);
+				for (const auto& range : ranges)
+					batch_instantiate(range.first, range.second, proto);
+			}
+
+			/*
+			±,storage ṩ remap(ɵ _has, ű) ʱ(ʱ _has Ѿµ)
+			˳ȡԪ,ɾµ id ´
+			*/
+			void remap(const id_remap& table) noexcept override
+			{
+				if (_changes.enabled())
+					_changes.remap(_has, table);
+				//ɾ¼е id ѾʧЧ,±ǰӦȴ¼
+				if (_recordEvents)
+				{
+					for (auto& added : _added)
+					{
+						entity_hbv kept(_has.size());
+						kept.merge_add(common::and_(added, _has));
+						added = remapped(kept, table);
+					}
+					for (auto& removed : _removed)
+						removed.clear();
+				}
+				if (_has.layer0() == 0u)
+					return;
+				if constexpr(common::is_detected<remap_trait, C<T>>::value)
+				{
+					entity_hbv old = _has;
+					_has = remapped(old, table);
+					container.remap(old, table);
+				}
+				else
+				{
+					std::vector<T> values;
+					common::for_each(_has, [this, &values](index_t i)
+					{
+						values.push_back(std::move(container.get(i)));
+					});
+					destroy(_has);
+					_has = remapped(_has, table);
+					std::size_t k = 0u;
+					common::for_each(_has, [this, &values, &k](index_t i)
+					{
+						container.create(i, values[k++]);
+					});
+				}
 			}
 
 			//ɾһhbvǵļ
-			void batch_remove(const common::hbv& remove) noexcept
+			void batch_remove(const entity_hbv& remove) noexcept
+			{
+				destroy(remove);
+				record_removed(common::and_(remove, _has));
+				_has.merge_sub(remove);
+				// _has ºտռ(ͷűΪյͰ)
+				if constexpr(common::is_detected<after_batch_remove_trait, C<T>>::value)
+					container.after_batch_remove();
+			}
+
+		protected:
+			//ɾԪ,޸ _has
+			void destroy(const entity_hbv& remove) noexcept
 			{
 				//Чɾ
-				auto toRemove = common::and(remove, _has);
+				auto toRemove = common::and_(remove, _has);
 				if constexpr(common::is_detected<batch_remove_trait, C<T>>::value)
 				{
 					container.batch_remove(toRemove);
@@ -129,18 +582,35 @@ namespace ecs
 		};
 	}
 	using component_detail::and_chbv;
+	using component_detail::components_abstract;
+	using component_detail::change_cursor;
+
+	template<typename T>
+	class sparse_vector;
 
 	/*
 	components  component Ĺ
 	components  hbv_map<id, component> ĸ,ṩ has filter  get 
 	hbv_map е map ûԶ, ĬṩһЩʵ(οStorage)
+	ָ˷ storage( sparse_storage<A>::type) components(std::allocator_arg, allocator) ״̬ķ
 	*/
 	template<typename T, template<typename> class C = sparse_vector>
 	class components/*_specialization*/ final : public component_detail::components_generic<C, T>
 	{
 		using generic = component_detail::components_generic<C, T>;
+		using with_members = std::is_constructible<C<T>, const entity_hbv&>;
+		using with_members_t = typename generic::with_members_t;
+
+		components(std::true_type) : generic(with_members_t{}) {}
+		components(std::false_type) : generic() {}
+		template<typename A>
+		components(std::true_type, const A& allocator) : generic(with_members_t{}, allocator) {}
+		template<typename A>
+		components(std::false_type, const A& allocator) : generic(allocator) {}
 	public:
-		components() noexcept : generic() {}
+		components() noexcept : components(with_members{}) {}
+		template<typename A>
+		components(std::allocator_arg_t, const A& allocator) : components(with_members{}, allocator) {}
 	};
 
 #define DefStorage(name) \
@@ -148,6 +618,10 @@ namespace ecs
 	class components<T, name> final : public component_detail::components_generic<name, T>
 #define DefConstructor(name) \
     using generic = component_detail::components_generic<name, T>; \
+	protected: \
+	using generic::_has; \
+	public: \
+	using generic::container; \
 	components() noexcept
 
 	
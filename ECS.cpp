@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 #include "Storages.hpp"
 #include "View.hpp"
+#include "Scheduler.hpp"
 #include <functional>
 #include <iostream>
 
@@ -89,8 +90,11 @@ int main()
 	AnotherSystem as{ as_view(locs, vels) };
 	RetainSystem ss{ as_view(locs, vels, movers) };
 
-	as.Update();
-	ss.Update();
+	//按注册顺序执行,两个 system 都写入 Location,因此不会并行
+	schedule frame{ as, ss };
+	frame.run();
 
+#ifdef _WIN32
 	system("Pause");
+#endif
 }
\ No newline at end of file
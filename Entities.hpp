@@ -1,26 +1,100 @@
 #pragma once
 #include "HBV.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//entity λ,ĬΪ 24 λ± 8 λ generation( 32 λ)
+// ECS_WIDE_ENTITY ʹ 32 λ± 32 λ generation( 64 λ),Ҳֱָߵλ
+#ifndef ECS_ENTITY_INDEX_BITS
+#ifdef ECS_WIDE_ENTITY
+#define ECS_ENTITY_INDEX_BITS 32
+#else
+#define ECS_ENTITY_INDEX_BITS 24
+#endif
+#endif
+#ifndef ECS_ENTITY_GEN_BITS
+#ifdef ECS_WIDE_ENTITY
+#define ECS_ENTITY_GEN_BITS 32
+#else
+#define ECS_ENTITY_GEN_BITS 8
+#endif
+#endif
 
 namespace ecs
 {
 	using common::index_t;
 
+	//entity ±ʹõλ,±곬 24 λʱʹ 5  hbv( 2^30  id),entities  components Դ˼¼
+	using entity_hbv = std::conditional_t<(ECS_ENTITY_INDEX_BITS > 24), common::large_hbv, common::hbv>;
+
+	/*
+	һŵ component,ڰ(runs )
+	span<const T> ӦԴ,span<T> ռжӦԴ
+	*/
+	template<typename T>
+	struct span
+	{
+		T* data;
+		index_t size;
+
+		T& operator[](index_t i) const noexcept { return data[i]; }
+		T* begin() const noexcept { return data; }
+		T* end() const noexcept { return data + size; }
+	};
+
 	/*
 	entity ԭӦֻһ id
-	һ generation ֤ entity Ч
+	һ generation ֤ entity Ч,ͬһ id  2^GenBits κɵ entity ŻᱻΪЧ
+	λ 32 ʱռ 32 λ,ռ 64 λ
+	±곬 24 λʱ entities  components ʹ 5  hbv(entity_hbv), 2^30  id,ʱ׳ std::length_error
 	*/
-	struct entity
+	template<index_t IndexBits, index_t GenBits>
+	struct basic_entity
 	{
-		//hbv֧±ֻ24λ
-		index_t id : 24;
-		index_t gen : 8;
+		static_assert(IndexBits > 0u && IndexBits <= 32u, "index of entity should fit in index_t");
+		static_assert(GenBits > 0u && GenBits <= 32u, "generation of entity should fit in 32 bits");
+		using storage_t = std::conditional_t<IndexBits + GenBits <= 32u, std::uint32_t, std::uint64_t>;
+		using generation_t = std::conditional_t<GenBits <= 8u, std::uint8_t,
+			std::conditional_t<GenBits <= 16u, std::uint16_t, std::uint32_t>>;
+		static constexpr generation_t GenMask = generation_t(~std::uint64_t(0u) >> (64u - GenBits));
+
+		storage_t id : IndexBits;
+		storage_t gen : GenBits;
 
 		operator index_t() const
 		{
-			return id;
+			return index_t(id);
 		}
 	};
 
+	using entity = basic_entity<ECS_ENTITY_INDEX_BITS, ECS_ENTITY_GEN_BITS>;
+
+	//һ鰴еĲཻ [first, second)
+	using id_ranges = std::vector<std::pair<index_t, index_t>>;
+
+	//id ±ű,table[old] Ϊµ id, id Ϊ InvalidId
+	using id_remap = std::vector<index_t>;
+	constexpr index_t InvalidId = ~index_t(0u);
+
+	/*
+	 entities::compact ıű±λ,from е±궼ҪڱűЧ
+	ű˳Ҵ id Ϊ id,ı־λӳ
+	*/
+	inline entity_hbv remapped(const entity_hbv& from, const id_remap& table)
+	{
+		entity_hbv result(from.size());
+		common::for_each_run(from, [&result, &table](index_t begin, index_t end)
+		{
+			result.range_set(table[begin], table[begin] + (end - begin), true);
+		});
+		return result;
+	}
+
 
 	/*
 	entities Ϊ entity ,֤ id ׷ entity Ч
@@ -32,13 +106,17 @@ namespace ecs
 		//hbv¼Чλ,ֶ¼
 		index_t _freeCount;
 		index_t _killedCount;
-		std::vector<std::uint8_t> _generation;
-		common::hbv _dead;
-		common::hbv _alive;
-		common::hbv _killed;
+		using generation_t = entity::generation_t;
+		std::vector<generation_t> _generation;
+		entity_hbv _dead;
+		entity_hbv _alive;
+		entity_hbv _killed;
 
+		//hbv ɲʱֱʧ, _generation 
 		void grow_to(index_t to)
 		{
+			if (to > entity_hbv::config::MaxSize)
+				throw std::length_error("entities: too many entities for the hbv");
 			_freeCount += to - (index_t)_generation.size();
 			_dead.grow_to(to);
 			_generation.resize(to, 0u);
@@ -46,10 +124,18 @@ namespace ecs
 			_alive.grow_to(to);
 		}
 
+		generation_t next_generation(index_t i) noexcept
+		{
+			return _generation[i] = generation_t(_generation[i] + 1u) & entity::GenMask;
+		}
+
 		void grow(index_t base = 50u)
 		{
 			index_t origSize = (index_t)_generation.size();
-			grow_to(origSize / 2u + origSize + base);
+			index_t to = std::min<std::uint64_t>(std::uint64_t(origSize) / 2u + origSize + base, entity_hbv::config::MaxSize);
+			if (to <= origSize)
+				throw std::length_error("entities: too many entities for the hbv");
+			grow_to(to);
 		}
 	public:
 		entities() : _generation(10u), _dead(10u, true), _killed(10u), _alive(10u), _freeCount(10u), _killedCount(0u) {}
@@ -57,21 +143,97 @@ namespace ecs
 		std::pair<index_t, index_t> batch_create(index_t n)
 		{
 			index_t end = last(_alive) + 1;
+			if (n > entity_hbv::config::MaxSize - end)
+				throw std::length_error("entities: too many entities for the hbv");
 			if (end + n > _generation.size())
 				grow_to(end + n);
 			_freeCount -= n;
+			_dead.range_set(end, end + n, false);
 			_alive.range_set(end, end + n, true);
 			for (index_t i = end; i < end + n; ++i)
-				++_generation[i];
+				next_generation(i);
 			return { end ,end + n };
 		}
 
+		/*
+		 n  entity, _dead,СĿնʼ,ʱĩβչ
+		ص䰴һ,ڱ id Ľպ
+		hbv ɲ n  entity ʱ׳ std::length_error,κ entity
+		*/
+		id_ranges batch_allocate(index_t n)
+		{
+			id_ranges result;
+			if (n == 0u)
+				return result;
+			if (_freeCount < n)
+			{
+				index_t size = (index_t)_generation.size();
+				if (n - _freeCount > entity_hbv::config::MaxSize - size)
+					throw std::length_error("entities: too many entities for the hbv");
+				grow_to(size + n - _freeCount);
+			}
+			index_t size = (index_t)_generation.size();
+			index_t remain = n;
+			//_dead  _generation λҲλ,ֻ [0, size)
+			common::for_each_run(_dead, 0u, size, [&](index_t begin, index_t end)
+			{
+				if (remain == 0u)
+					return;
+				end = std::min(end, begin + remain);
+				result.emplace_back(begin, end);
+				remain -= end - begin;
+			});
+			//_freeCount  _dead һʱչܷ n 
+			assert(remain == 0u && "free count of entities drifted");
+			_freeCount -= n - remain;
+			for (auto& range : result)
+			{
+				_dead.range_set(range.first, range.second, false);
+				_alive.range_set(range.first, range.second, true);
+				for (index_t i = range.first; i < range.second; ++i)
+					next_generation(i);
+			}
+			return result;
+		}
+
+		/*
+		Ѵ entity ԭ˳±Ϊ [0, n),ؾ id  id ıű
+		ƶ entity ȡĿλ֮ǰ generation ͬ generation,ճλҲ generation
+		˾ɵľ( entity)ʧЧ,ľҪͨ ents.get(table[old.id]) ȡ
+		ǰҪ die,component ±Ųο world::compact
+		*/
+		id_remap compact()
+		{
+			assert(_killedCount == 0u && "call die() before compact()");
+			index_t size = (index_t)_generation.size();
+			id_remap table(size, InvalidId);
+			index_t n = 0u;
+			// id ھ id,ԭƶ generation
+			common::for_each_run(_alive, 0u, size, [this, &table, &n](index_t begin, index_t end)
+			{
+				for (index_t i = begin; i < end; ++i, ++n)
+				{
+					table[i] = n;
+					if (n != i)
+						_generation[n] = generation_t(std::max(_generation[n], _generation[i]) + 1u) & entity::GenMask;
+				}
+			});
+			for (index_t i = n; i < size; ++i)
+				next_generation(i);
+			_alive.range_set(n, size, false);
+			_alive.range_set(0u, n, true);
+			_dead.range_set(0u, n, false);
+			_dead.range_set(n, size, true);
+			_freeCount = size - n;
+			return table;
+		}
+
 		index_t free_count()
 		{
 			return _freeCount;
 		}
 
-		const common::hbv& killed()
+		const entity_hbv& killed()
 		{
 			return _killed;
 		}
@@ -85,7 +247,7 @@ namespace ecs
 			_killed.clear();
 		}
 
-		const common::hbv& filter() const
+		const entity_hbv& filter() const
 		{
 			return _alive;
 		}
@@ -98,14 +260,15 @@ namespace ecs
 		entity create()
 		{
 			auto id = common::first(_dead);
-			if (id == -1)
+			//_dead ĬΪ,һڵг _generation λҲλ
+			while (id == -1 || index_t(id) >= _generation.size())
 			{
 				grow();
 				id = common::first(_dead);
 			}
 			--_freeCount;
 			index_t i = id;
-			auto g = _generation[i]++;
+			auto g = next_generation(i);
 			_dead.set(i, false);
 			_alive.set(i, true);
 			return entity{ i, g };
@@ -117,8 +280,44 @@ namespace ecs
 				&& _alive.test(e.id);
 		}
 
+		/*
+		 entity Ч,result[i] Ϊ handles[i] ǷЧ,Ч
+		ÿ 64 Ϊһ:ռ generation ͳһȽ(),ȽϽֻͨ entity  _alive
+		*/
+		index_t alive(span<const entity> handles, bool* result) const
+		{
+			constexpr index_t Group = 64u;
+			index_t ids[Group];
+			generation_t expected[Group], actual[Group];
+			index_t count = 0u;
+			for (index_t base = 0u; base < handles.size; base += Group)
+			{
+				index_t n = std::min(Group, handles.size - base);
+				for (index_t i = 0u; i < n; ++i)
+				{
+					ids[i] = index_t(handles[base + i].id);
+					expected[i] = generation_t(handles[base + i].gen);
+				}
+				for (index_t i = 0u; i < n; ++i)
+					actual[i] = ids[i] < _generation.size() ? _generation[ids[i]] : generation_t(~expected[i]);
+				std::uint64_t mask = 0u;
+				for (index_t i = 0u; i < n; ++i)
+					mask |= std::uint64_t(actual[i] == expected[i]) << i;
+				for (index_t i = 0u; i < n; ++i)
+				{
+					bool valid = ((mask >> i) & 1u) && _alive.test(ids[i]);
+					result[base + i] = valid;
+					count += valid;
+				}
+			}
+			return count;
+		}
+
+		//ظ kill ͬһ entity ظ
 		void kill(entity e)
 		{
+			if (_killed.test(e.id))
+				return;
 			_killedCount++;
 			_killed.set(e.id, true);
 		}
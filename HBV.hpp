@@ -2,7 +2,39 @@
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+/*
+位运算的编译器适配
+MSVC 使用 intrin.h, GCC/Clang 使用 builtin
+开启 BMI 指令集时(-mbmi, -mlzcnt 或 MSVC 的 /arch:AVX2)直接使用 tzcnt/lzcnt/blsr
+*/
+#if defined(_MSC_VER)
 #include <intrin.h>
+#elif defined(__x86_64__) && (defined(__BMI__) || defined(__LZCNT__))
+#include <x86intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__BMI__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define HBV_USE_BMI 1
+#endif
+#if defined(__LZCNT__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define HBV_USE_LZCNT 1
+#endif
+#endif
+
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
 
 namespace common
 {
@@ -11,56 +43,353 @@ namespace common
 		using index_t = uint32_t;
 		using flag_t = int64_t;
 
-		//取得最低的一位标志位的位置
+		//取得最低的一位标志位的位置, id 不能为 0
 		//001000 -> 3
-		__forceinline index_t lowbit_pos(flag_t id)
+		template<typename Flag>
+		__forceinline index_t lowbit_pos(Flag id) noexcept
 		{
+#if defined(HBV_USE_BMI)
+			if constexpr (sizeof(Flag) == 8)
+				return (index_t)_tzcnt_u64((unsigned long long)id);
+			else
+				return (index_t)_tzcnt_u32((unsigned int)id);
+#elif defined(_MSC_VER)
 			unsigned long result;
-			return _BitScanForward64(&result, id) ? result : 0;
+			if constexpr (sizeof(Flag) == 8)
+				_BitScanForward64(&result, (unsigned long long)id);
+			else
+				_BitScanForward(&result, (unsigned long)id);
+			return (index_t)result;
+#else
+			if constexpr (sizeof(Flag) == 8)
+				return (index_t)__builtin_ctzll((unsigned long long)id);
+			else
+				return (index_t)__builtin_ctz((unsigned int)id);
+#endif
 		}
 
-		//取得最高的一位标志位的位置
-		__forceinline index_t highbit_pos(flag_t id)
+		//取得最高的一位标志位的位置, id 不能为 0
+		template<typename Flag>
+		__forceinline index_t highbit_pos(Flag id) noexcept
 		{
+			constexpr index_t high = sizeof(Flag) * 8u - 1u;
+#if defined(HBV_USE_LZCNT)
+			if constexpr (sizeof(Flag) == 8)
+				return high - (index_t)_lzcnt_u64((unsigned long long)id);
+			else
+				return high - (index_t)_lzcnt_u32((unsigned int)id);
+#elif defined(_MSC_VER)
 			unsigned long result;
-			return _BitScanReverse64(&result, id) ? result : 0;
+			if constexpr (sizeof(Flag) == 8)
+				_BitScanReverse64(&result, (unsigned long long)id);
+			else
+				_BitScanReverse(&result, (unsigned long)id);
+			return (index_t)result;
+#else
+			if constexpr (sizeof(Flag) == 8)
+				return high - (index_t)__builtin_clzll((unsigned long long)id);
+			else
+				return high - (index_t)__builtin_clz((unsigned int)id);
+#endif
 		}
 
+		//清除最低的一位标志位
+		//001010 -> 001000
+		template<typename Flag>
+		__forceinline Flag clear_lowbit(Flag id) noexcept
+		{
+#if defined(HBV_USE_BMI)
+			if constexpr (sizeof(Flag) == 8)
+				return Flag(_blsr_u64((unsigned long long)id));
+			else
+				return Flag(_blsr_u32((unsigned int)id));
+#else
+			using uflag_t = std::make_unsigned_t<Flag>;
+			return Flag(uflag_t(id) & (uflag_t(id) - 1u));
+#endif
+		}
 
-		//分层位数组的常数,硬编码,勿动😀
+		//标志位的数量
+		template<typename Flag>
+		__forceinline index_t popcount(Flag id) noexcept
+		{
+#if defined(_MSC_VER)
+			if constexpr (sizeof(Flag) == 8)
+				return (index_t)__popcnt64((unsigned long long)id);
+			else
+				return (index_t)__popcnt((unsigned int)id);
+#else
+			if constexpr (sizeof(Flag) == 8)
+				return (index_t)__builtin_popcountll((unsigned long long)id);
+			else
+				return (index_t)__builtin_popcount((unsigned int)id);
+#endif
+		}
 
-		//每个节点64位,即2<<6
-		constexpr index_t BitsPerLayer = 6u;
-		constexpr flag_t EmptyNode = 0u;
-		constexpr flag_t FullNode = EmptyNode - 1u;
-		//硬编码分层为4层,方便优化和编码
-		constexpr index_t LayerCount = 4u;
+		/*
+		分层位数组的参数
+		Layers 为层数, Flag 为节点类型(32位或64位)
+		默认的4层64位节点可以表示 2^24 个位,5层可以表示 2^30 个位,3层为 2^18 个位
+		*/
+		template<index_t Layers = 4u, typename Flag = flag_t>
+		struct hbv_config
+		{
+			static_assert(std::is_integral_v<Flag> && (sizeof(Flag) == 8 || sizeof(Flag) == 4), "node of hbv must be 32 or 64 bits integer");
+			using flag_t = Flag;
+			using uflag_t = std::make_unsigned_t<Flag>;
+
+			//每个节点64位(即2<<6)或32位(即2<<5)
+			static constexpr index_t BitsPerLayer = sizeof(Flag) == 8 ? 6u : 5u;
+			static constexpr index_t NodeMask = (1u << BitsPerLayer) - 1u;
+			static constexpr flag_t EmptyNode = flag_t(0u);
+			static constexpr flag_t FullNode = flag_t(~uflag_t(0u));
+			static constexpr index_t LayerCount = Layers;
+			//最底层, 储存真正的标志位
+			static constexpr index_t LeafLayer = Layers - 1u;
+
+			//下标需要能用 int32_t 表示(-1 作为无效值)
+			static_assert(Layers >= 2u && Layers * BitsPerLayer <= 31u, "too many layers for 32 bits index");
+			static constexpr index_t MaxSize = index_t(1u) << (Layers * BitsPerLayer);
+
+			//节点位置
+			template<index_t layer>
+			static constexpr index_t index_of(index_t id) noexcept
+			{
+				return id >> ((LayerCount - layer)*BitsPerLayer);
+			}
+
+			//节点值
+			template<index_t layer>
+			static constexpr flag_t value_of(index_t id) noexcept
+			{
+				index_t index = index_of<layer + 1>(id);
+				return flag_t(uflag_t(1u) << (index & NodeMask));
+			}
+
+			//节点内[begin, end]位(闭区间)
+			static constexpr flag_t bits_between(index_t begin, index_t end) noexcept
+			{
+				return flag_t((uflag_t(~uflag_t(0u)) >> (NodeMask - end)) & (uflag_t(~uflag_t(0u)) << begin));
+			}
 
-		//节点位置
-		template<index_t layer>
-		constexpr index_t index_of(index_t id) noexcept
+			//节点内低于 pos 的位
+			static constexpr flag_t bits_below(index_t pos) noexcept
+			{
+				return pos == 0 ? EmptyNode : bits_between(0, pos - 1);
+			}
+		};
+
+		//遍历到最底层的标记
+		constexpr index_t LeafLevel = ~index_t(0u);
+
+		template<typename T, index_t Level>
+		constexpr index_t level_of = Level == LeafLevel ? std::decay_t<T>::config::LeafLayer : Level;
+
+		//运行期的层数转为编译期分派
+		template<typename T, std::size_t... Ns>
+		__forceinline auto dispatch_layer(const T& vec, index_t level, index_t id, std::index_sequence<Ns...>) noexcept
 		{
-			return id >> ((LayerCount - layer)*BitsPerLayer);
+			typename T::config::flag_t result = 0;
+			(void)((level == Ns ? (result = vec.template layer<Ns>(id), true) : false) || ...);
+			return result;
 		}
 
-		//节点值
-		template<index_t layer>
-		constexpr flag_t value_of(index_t id) noexcept
+		//block 的使用情况
+		struct block_stats
 		{
-			constexpr index_t mask = (1 << BitsPerLayer) - 1;
-			index_t index = index_of<layer + 1>(id);
-			return flag_t(1u) << (index & mask);
-		}
+			//正在被 hbv 使用的 block
+			std::size_t live = 0;
+			//缓存在池中等待复用的 block
+			std::size_t pooled = 0;
+		};
+
+		/*
+		默认的 block 分配器,每个 hbv 独享一个空闲链表
+		释放的 block 先进入空闲链表,空闲数量超过 high_water 时才归还给系统并收缩到 low_water
+		在 block 边界附近反复创建删除 entity 时,不会每帧都 malloc/free
+		*/
+		template<std::size_t BlockSize>
+		class block_pool
+		{
+			std::vector<void*> _free;
+		public:
+			std::size_t low_water = 4u;
+			std::size_t high_water = 16u;
+
+			block_pool() = default;
+			//复制时不共享空闲链表
+			block_pool(const block_pool& other) : low_water(other.low_water), high_water(other.high_water) {}
+			block_pool(block_pool&& other) noexcept : _free(std::move(other._free)), low_water(other.low_water), high_water(other.high_water)
+			{
+				other._free.clear();
+			}
+			block_pool& operator=(block_pool other) noexcept
+			{
+				std::swap(_free, other._free);
+				low_water = other.low_water;
+				high_water = other.high_water;
+				return *this;
+			}
+			~block_pool()
+			{
+				trim(0u);
+			}
+
+			void* allocate()
+			{
+				if (_free.empty())
+					return malloc(BlockSize);
+				void* block = _free.back();
+				_free.pop_back();
+				return block;
+			}
+
+			void deallocate(void* block)
+			{
+				_free.push_back(block);
+				if (_free.size() > high_water)
+					trim(low_water);
+			}
+
+			//归还空闲的 block,只保留 keep 个
+			void trim(std::size_t keep)
+			{
+				while (_free.size() > keep)
+				{
+					free(_free.back());
+					_free.pop_back();
+				}
+			}
+
+			std::size_t pooled() const
+			{
+				return _free.size();
+			}
+		};
+
+		/*
+		线程安全的全局 block 分配器,所有使用它的 hbv 共享同一个空闲链表(每种 block 大小一个)
+		适合大量短命的 hbv,或者 hbv 之间此消彼长的情况
+		*/
+		template<std::size_t BlockSize>
+		class shared_block_pool
+		{
+			struct state
+			{
+				std::mutex lock;
+				std::vector<void*> free;
+				std::size_t low_water = 64u;
+				std::size_t high_water = 256u;
+				~state()
+				{
+					for (void* block : free)
+						::free(block);
+				}
+			};
+
+			static state& global()
+			{
+				static state instance;
+				return instance;
+			}
+
+			static void trim_locked(state& s, std::size_t keep)
+			{
+				while (s.free.size() > keep)
+				{
+					::free(s.free.back());
+					s.free.pop_back();
+				}
+			}
+		public:
+			void* allocate()
+			{
+				state& s = global();
+				{
+					std::lock_guard<std::mutex> guard(s.lock);
+					if (!s.free.empty())
+					{
+						void* block = s.free.back();
+						s.free.pop_back();
+						return block;
+					}
+				}
+				return malloc(BlockSize);
+			}
+
+			void deallocate(void* block)
+			{
+				state& s = global();
+				std::lock_guard<std::mutex> guard(s.lock);
+				s.free.push_back(block);
+				if (s.free.size() > s.high_water)
+					trim_locked(s, s.low_water);
+			}
+
+			std::size_t pooled() const
+			{
+				state& s = global();
+				std::lock_guard<std::mutex> guard(s.lock);
+				return s.free.size();
+			}
+
+			static void trim(std::size_t keep)
+			{
+				state& s = global();
+				std::lock_guard<std::mutex> guard(s.lock);
+				trim_locked(s, keep);
+			}
+
+			static void set_water(std::size_t low, std::size_t high)
+			{
+				state& s = global();
+				std::lock_guard<std::mutex> guard(s.lock);
+				s.low_water = low;
+				s.high_water = high;
+			}
+		};
 
 		//为了减少内存消耗,当大量连续位没有被使用时,释放block
+		//block 通过 Allocator 分配和回收(默认为每个 hbv 独享的池)
 		//注意此类只用于hbv
+		template<typename Config, template<std::size_t> class Allocator = block_pool>
 		class block_vector
 		{
-			static constexpr index_t bits = BitsPerLayer;
+			using flag_t = typename Config::flag_t;
+			static constexpr index_t bits = Config::BitsPerLayer;
 			static constexpr index_t mask = (1 << bits) - 1;
+			static constexpr flag_t FullNode = Config::FullNode;
+			static constexpr std::size_t BlockSize = sizeof(flag_t) * (1 << bits);
 			std::vector<flag_t*> _blocks;
 			index_t _size = 0;
+			index_t _live = 0;
+			Allocator<BlockSize> _allocator;
 		public:
+			block_vector() = default;
+			block_vector(const block_vector& other) : _blocks(other._blocks.size(), nullptr), _size(other._size), _allocator(other._allocator)
+			{
+				for (index_t i = 0; i < _blocks.size(); ++i)
+					if (other._blocks[i] != nullptr)
+					{
+						add_block(i);
+						memcpy(_blocks[i], other._blocks[i], BlockSize);
+					}
+			}
+			block_vector(block_vector&& other) noexcept
+				: _blocks(std::move(other._blocks)), _size(other._size), _live(other._live), _allocator(std::move(other._allocator))
+			{
+				other._blocks.clear();
+				other._size = 0;
+				other._live = 0;
+			}
+			block_vector& operator=(block_vector other) noexcept
+			{
+				std::swap(_blocks, other._blocks);
+				std::swap(_size, other._size);
+				std::swap(_live, other._live);
+				std::swap(_allocator, other._allocator);
+				return *this;
+			}
 			~block_vector()
 			{
 				clear();
@@ -85,9 +414,19 @@ namespace common
 				return _size;
 			}
 
+			Allocator<BlockSize>& allocator()
+			{
+				return _allocator;
+			}
+
+			block_stats stats() const
+			{
+				return { _live, _allocator.pooled() };
+			}
+
 			void clear()
 			{
-				for (int i = 0; i < _blocks.size(); ++i)
+				for (index_t i = 0; i < _blocks.size(); ++i)
 					try_erase_block(i);
 			}
 
@@ -100,8 +439,9 @@ namespace common
 
 			void erase_block(index_t i)
 			{
-				free(_blocks[i]);
+				_allocator.deallocate(_blocks[i]);
 				_blocks[i] = nullptr;
+				--_live;
 			}
 
 			void try_erase_block(index_t i)
@@ -112,8 +452,9 @@ namespace common
 
 			void add_block(index_t i)
 			{
-				_blocks[i] = (flag_t*)malloc(sizeof(flag_t) * (1 << bits));
-				memset(_blocks[i], 0, sizeof(flag_t) * (1 << bits));
+				_blocks[i] = (flag_t*)_allocator.allocate();
+				memset(_blocks[i], 0, BlockSize);
+				++_live;
 			}
 
 			void try_add_block(index_t i)
@@ -122,41 +463,45 @@ namespace common
 					add_block(i);
 			}
 
+			//清空[begin, end)的节点,完全覆盖的block直接释放
 			void reset(index_t begin, index_t end)
 			{
-				index_t b = end >> bits;
+				if (begin >= end) return;
 				index_t s = begin >> bits;
-				for (index_t i = s + 1; i < b; ++i)
-					try_erase_block(i);
+				index_t b = (end - 1) >> bits;
 				if (b > s)
 				{
+					for (index_t i = s + 1; i < b; ++i)
+						try_erase_block(i);
 					if (_blocks[s] != nullptr)
-						memset(_blocks[s] + (begin & mask), -1, ((1 << bits) - (begin & mask)) * sizeof(flag_t));
+						memset(_blocks[s] + (begin & mask), 0, ((1 << bits) - (begin & mask)) * sizeof(flag_t));
 					if (_blocks[b] != nullptr)
-						memset(_blocks[b], -1, (end & mask) * sizeof(flag_t));
+						memset(_blocks[b], 0, (((end - 1) & mask) + 1) * sizeof(flag_t));
 				}
 				else if (_blocks[s] != nullptr)
 				{
-					memset(_blocks[s] + (begin & mask), -1, ((end - begin) & mask) * sizeof(flag_t));
+					memset(_blocks[s] + (begin & mask), 0, (end - begin) * sizeof(flag_t));
 				}
 			}
 
+			//填满[begin, end)的节点
 			void fill(index_t begin, index_t end)
 			{
-				index_t b = end >> bits;
+				if (begin >= end) return;
 				index_t s = begin >> bits;
+				index_t b = (end - 1) >> bits;
 				for (index_t i = s; i <= b; ++i)
 					try_add_block(i);
-				for (index_t i = s + 1; i < b; ++i)
-					memset(_blocks[i], -1, (1 << bits) * sizeof(flag_t));
 				if (b > s)
 				{
-					memset(_blocks[s] + (begin & mask), -1, ((1 << bits) - (begin & mask)) * sizeof(flag_t));
-					memset(_blocks[b], -1, (end & mask) * sizeof(flag_t));
+					for (index_t i = s + 1; i < b; ++i)
+						std::fill_n(_blocks[i], 1 << bits, FullNode);
+					std::fill_n(_blocks[s] + (begin & mask), (1 << bits) - (begin & mask), FullNode);
+					std::fill_n(_blocks[b], ((end - 1) & mask) + 1, FullNode);
 				}
 				else
 				{
-					memset(_blocks[s] + (begin & mask), -1, ((end - begin) & mask) * sizeof(flag_t));
+					std::fill_n(_blocks[s] + (begin & mask), end - begin, FullNode);
 				}
 			}
 
@@ -164,7 +509,6 @@ namespace common
 			{
 				index_t b = n >> bits;
 				_blocks.resize(b + 1, nullptr);
-				index_t s = _size >> bits;
 				if (fill) this->fill(_size, n);
 				_size = n;
 			}
@@ -172,90 +516,105 @@ namespace common
 
 		/*
 		分层位数组(Hierarchical Bit Vector),利用额外的位数组来记录下层位数组的连续空位,整体符合如下规则
-		Layer(n-1)[i] = Layer(n)[i] & Layer(n)[i + 1] & ... & Layer(n)[i + 63]
+		Layer(n-1)[i] = Layer(n)[i] | Layer(n)[i + 1] | ... | Layer(n)[i + 63] (按节点是否为空)
 		通过跳过连续的空位来加速稀疏位数组的遍历,在数据紧密但位置分散的时候能取得很好的性能
+		层数和节点宽度由模板参数决定,所有逐层的逻辑都在编译期展开
+		Counted 为真时额外维护每个上层节点下的标志位数量,提供 O(1) 的 count 以及 rank/select
+		Allocator 为最底层 block 的分配器,默认为每个 hbv 独享的池,也可以使用线程安全的 shared_block_pool
 		*/
-		class hbv final
-		{
-			//硬编码4层,可能过度优化?
-			flag_t _layer0;
-			std::vector<flag_t> _layer1;
-			std::vector<flag_t> _layer2;
-			//block大小对应layer2
-			block_vector _layer3;
+		template<index_t Layers = 4u, typename Flag = flag_t, bool Counted = false, template<std::size_t> class Allocator = block_pool>
+		class basic_hbv final
+		{
+		public:
+			using config = hbv_config<Layers, Flag>;
+			using flag_t = typename config::flag_t;
+			static constexpr bool counted = Counted;
+		private:
+			static constexpr index_t BitsPerLayer = config::BitsPerLayer;
+			static constexpr index_t LeafLayer = config::LeafLayer;
+			static constexpr flag_t EmptyNode = config::EmptyNode;
+			static constexpr flag_t FullNode = config::FullNode;
+			template<index_t layer>
+			static constexpr index_t index_of(index_t id) noexcept { return config::template index_of<layer>(id); }
+			template<index_t layer>
+			static constexpr flag_t value_of(index_t id) noexcept { return config::template value_of<layer>(id); }
+
+			//上层节点, _layers[0] 只有一个节点即 layer0
+			std::array<std::vector<flag_t>, LeafLayer> _layers;
+			//block大小对应倒数第二层的一个节点
+			block_vector<config, Allocator> _leaf;
 			//设定一个初值:全0或全1
 			bool default_value;
+			//与 _layers 一一对应, 每个节点下的标志位数量, _counts[0][0] 即总数
+			struct no_counts {};
+			using counts_t = std::conditional_t<Counted, std::array<std::vector<index_t>, LeafLayer>, no_counts>;
+			counts_t _counts;
 		public:
-			hbv(index_t max = 10, bool default_value = false) : default_value(default_value)
+			basic_hbv(index_t max = 10, bool default_value = false) : default_value(default_value)
 			{
 				max -= 1;
 				//简单的填充
-				if (default_value)
-				{
-					_layer3.resize(index_of<3>(max) + 1, true);
-					_layer2.resize(index_of<2>(max) + 1, FullNode);
-					_layer1.resize(index_of<1>(max) + 1, FullNode);
-					_layer0 = FullNode;
-				}
-				else
-				{
-					_layer3.resize(index_of<3>(max) + 1, false);
-					_layer2.resize(index_of<2>(max) + 1, 0u);
-					_layer1.resize(index_of<1>(max) + 1, 0u);
-					_layer0 = 0u;
-				}
+				_leaf.resize(index_of<LeafLayer>(max) + 1, default_value);
+				resize_layers(max, std::make_index_sequence<LeafLayer>());
+				if constexpr (Counted)
+					if (default_value) rebuild_counts();
 			}
 
 			//生长容量,填入更小的容量无效
 			void grow_to(index_t to) noexcept
 			{
 				to -= 1;
-				to = std::min<index_t>(16'777'216u, to);
+				to = std::min<index_t>(config::MaxSize - 1u, to);
 				if (to < size()) return;
-				if (default_value)
-				{
-					_layer3.resize(index_of<3>(to) + 1, true);
-					_layer2.resize(index_of<2>(to) + 1, FullNode);
-					_layer1.resize(index_of<1>(to) + 1, FullNode);
-				}
-				else
-				{
-					_layer3.resize(index_of<3>(to) + 1, false);
-					_layer2.resize(index_of<2>(to) + 1, 0u);
-					_layer1.resize(index_of<1>(to) + 1, 0u);
-				}
+				_leaf.resize(index_of<LeafLayer>(to) + 1, default_value);
+				resize_layers(to, std::make_index_sequence<LeafLayer>());
+				if constexpr (Counted)
+					if (default_value) rebuild_counts();
 			}
 
 			index_t size() const noexcept
 			{
-				return ((_layer3.size() - 1) << BitsPerLayer) + 1;
+				return ((_leaf.size() - 1) << BitsPerLayer) + 1;
 			}
 
-			//范围设置标志位,性能大幅高于依次设置,但代码十分麻烦
+			//范围设置标志位,性能大幅高于依次设置
 			void range_set(index_t begin, index_t end, bool value)
 			{
+				if (begin >= end) return;
+				index_t start = index_of<LeafLayer>(begin);
+				index_t stop = index_of<LeafLayer>(end - 1);
+				if constexpr (Counted)
+					count_words(start, stop, false);
 				if (value)
 					set_range_true(begin, end);
 				else
 					set_range_false(begin, end);
+				if constexpr (Counted)
+					count_words(start, stop, true);
 			}
 
 			//设置标志位, 性能一般
 			void set(index_t id, bool value) noexcept
 			{
-				index_t index_3 = index_of<3>(id);
-				flag_t value_3 = value_of<3>(id);
+				index_t index = index_of<LeafLayer>(id);
+				flag_t bit = value_of<LeafLayer>(id);
 
 				if (value)
 				{
 					//bubble for new node
 					bubble_fill(id);
-					_layer3[index_3] |= value_3;
+					if constexpr (Counted)
+						if ((_leaf[index] & bit) == EmptyNode) add_count(id, 1u);
+					_leaf[index] |= bit;
 				}
 				else
 				{
+					//block已经释放,位必然为空
+					if (!_leaf.valid(index)) return;
+					if constexpr (Counted)
+						if ((_leaf[index] & bit) != EmptyNode) add_count(id, index_t(-1));
 					//bubble for empty node
-					_layer3[index_3] &= ~value_3;
+					_leaf[index] &= ~bit;
 					bubble_empty(id);
 				}
 			}
@@ -263,379 +622,745 @@ namespace common
 			//判断特定位, 性能一般
 			bool test(index_t id) const noexcept
 			{
-				index_t index_3 = index_of<3>(id);
-				if (index_3 > _layer3.size()) return default_value;
-				return  _layer3.valid(index_3) && (_layer3[index_3] & value_of<3>(id));
+				index_t index = index_of<LeafLayer>(id);
+				if (index >= _leaf.size()) return default_value;
+				return  _leaf.valid(index) && (_leaf[index] & value_of<LeafLayer>(id));
+			}
+
+			bool contain(index_t id) const noexcept
+			{
+				return test(id);
 			}
 
 			//清零位数组
 			void clear() noexcept
 			{
+				flag_t value = default_value ? FullNode : EmptyNode;
 				if (default_value)
+					_leaf.fill(0, _leaf.size());
+				else
+					_leaf.clear();
+				for (auto& layer : _layers)
+					std::fill(layer.begin(), layer.end(), value);
+				if constexpr (Counted)
+					rebuild_counts();
+			}
+
+			//标志位数量
+			index_t count() const noexcept
+			{
+				static_assert(Counted, "count() requires a counted hbv, use common::count instead");
+				return _counts[0][0];
+			}
+
+			//第 N 层第 id 个节点下的标志位数量
+			template<index_t N>
+			index_t population(index_t id) const noexcept
+			{
+				static_assert(Counted, "population() requires a counted hbv");
+				static_assert(N < LeafLayer, "leaf node has no population, use popcount");
+				if (id >= _counts[N].size())
+					return 0u;
+				return _counts[N][id];
+			}
+
+			//id 之前(不含 id)的标志位数量
+			index_t rank(index_t id) const noexcept
+			{
+				static_assert(Counted, "rank() requires a counted hbv");
+				if (index_of<LeafLayer>(id) >= _leaf.size())
+					return count();
+				return rank_node<0>(id);
+			}
+
+			//第 k 个(从 0 开始)标志位的位置,不存在则返回 -1
+			int32_t select(index_t k) const noexcept
+			{
+				static_assert(Counted, "select() requires a counted hbv");
+				if (k >= count())
+					return -1;
+				return select_node<0>(0, k);
+			}
+
+			//block 的使用情况
+			block_stats blocks() const noexcept
+			{
+				return _leaf.stats();
+			}
+
+			//调整 block 池,如设置缓存的上下限或者归还空闲 block
+			decltype(auto) block_allocator() noexcept
+			{
+				return _leaf.allocator();
+			}
+
+			//直接读指定层标志位
+			flag_t layer0() const noexcept
+			{
+				return _layers[0][0];
+			}
+
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
+			{
+				if constexpr (N == LeafLayer)
 				{
-					_layer3.fill(0, _layer3.size());
-					std::fill(_layer2.begin(), _layer2.end(), FullNode);
-					std::fill(_layer1.begin(), _layer1.end(), FullNode);
-					_layer0 = FullNode;
+					if (id >= _leaf.size())
+						return default_value ? FullNode : EmptyNode;
+					//被释放的block等价于空节点,组合位数组可能读到这些位置
+					if (!_leaf.valid(id))
+						return EmptyNode;
+					return _leaf[id];
 				}
 				else
 				{
-					_layer3.clear();
-					std::fill(_layer2.begin(), _layer2.end(), 0u);
-					std::fill(_layer1.begin(), _layer1.end(), 0u);
-					_layer0 = 0u;
+					if (id >= _layers[N].size())
+						return default_value ? FullNode : EmptyNode;
+					return _layers[N][id];
 				}
 			}
 
-			//直接读指定层标志位
-			flag_t layer0() const noexcept
+			flag_t layer(index_t level, index_t id) const noexcept
 			{
-				return _layer0;
+				return dispatch_layer(*this, level, id, std::make_index_sequence<Layers>());
 			}
 
-			flag_t layer1(index_t id) const noexcept
+			//合并位数组, 性能高于普通遍历
+			//集合加(或)
+			template<typename T>
+			void merge_add(const T& vec)
 			{
-				if (id >= _layer1.size())
-					return default_value ? FullNode : 0u;
-				return _layer1[id];
+				static_assert(std::is_same_v<typename T::config, config>, "can't merge hbv with different config");
+				flag_t root = vec.layer0();
+				if (root == EmptyNode) return;
+				int32_t tail = last(vec);
+				if (tail == -1) return;
+				grow_to(tail + 1);
+				merge_add_node<0>(vec, root, 0);
 			}
 
-			flag_t layer2(index_t id) const noexcept
+			//集合减(与非)
+			template<typename T>
+			void merge_sub(const T& vec)
 			{
-				if (id >= _layer2.size())
-					return default_value ? FullNode : 0u;
-				return _layer2[id];
+				static_assert(std::is_same_v<typename T::config, config>, "can't merge hbv with different config");
+				merge_sub_node<0>(vec, vec.layer0() & layer0(), 0);
 			}
 
-			flag_t layer3(index_t id) const noexcept
+		private:
+			template<std::size_t... Ns>
+			void resize_layers(index_t max, std::index_sequence<Ns...>)
 			{
-				if (id >= _layer3.size())
-					return default_value ? FullNode : 0u;
-				return _layer3[id];
+				flag_t value = default_value ? FullNode : EmptyNode;
+				(_layers[Ns].resize(index_of<Ns>(max) + 1, value), ...);
+				if constexpr (Counted)
+					(_counts[Ns].resize(index_of<Ns>(max) + 1, 0u), ...);
 			}
 
-			flag_t layer(index_t level, index_t id) const noexcept
+			//修改 id 所在的各层节点的计数,delta 按无符号回绕计算
+			void add_count(index_t id, index_t delta)
+			{
+				add_count_nodes(id, delta, std::make_index_sequence<LeafLayer>());
+			}
+
+			template<std::size_t... Ns>
+			void add_count_nodes(index_t id, index_t delta, std::index_sequence<Ns...>)
 			{
-				switch (level)
+				((_counts[Ns][index_of<Ns>(id)] += delta), ...);
+			}
+
+			//将最底层[start, stop]节点的标志位数量加入(或移出)计数,按block聚合
+			void count_words(index_t start, index_t stop, bool add)
+			{
+				for (index_t b = start >> BitsPerLayer; b <= (stop >> BitsPerLayer); ++b)
 				{
-				case 0:
-					return layer0();
-				case 1:
-					return layer1(id);
-				case 2:
-					return layer2(id);
-				case 3:
-					return layer3(id);
-				default:
-					return 0;
+					index_t first = std::max(start, b << BitsPerLayer);
+					if (!_leaf.valid(first)) continue;
+					index_t last = std::min(stop, (b << BitsPerLayer) | config::NodeMask);
+					index_t sum = 0;
+					for (index_t w = first; w <= last; ++w)
+						sum += popcount(_leaf[w]);
+					if (sum != 0)
+						add_count(first << BitsPerLayer, add ? sum : index_t(0u) - sum);
 				}
 			}
 
-			//合并位数组, 性能高于普通遍历
-			//集合加(或) 
-			template<typename T>
-			void merge_add(const T& vec)
+			void rebuild_counts()
+			{
+				for (auto& layer : _counts)
+					std::fill(layer.begin(), layer.end(), 0u);
+				if (_leaf.size() > 0)
+					count_words(0, _leaf.size() - 1, true);
+			}
+
+			//逐层累加 id 之前的兄弟节点的计数
+			template<index_t N>
+			index_t rank_node(index_t id) const
+			{
+				index_t node = index_of<N>(id);
+				index_t child = index_of<N + 1>(id);
+				flag_t before = _layers[N][node] & config::bits_below(child & config::NodeMask);
+				index_t result = 0;
+				while (before != EmptyNode)
+				{
+					index_t low = lowbit_pos(before);
+					before = clear_lowbit(before);
+					if constexpr (N + 1 == LeafLayer)
+						result += popcount(_leaf[(node << BitsPerLayer) | low]);
+					else
+						result += _counts[N + 1][(node << BitsPerLayer) | low];
+				}
+				if constexpr (N + 1 == LeafLayer)
+				{
+					if (_leaf.valid(child))
+						result += popcount(_leaf[child] & config::bits_below(id & config::NodeMask));
+					return result;
+				}
+				else
+				{
+					if ((_layers[N][node] & value_of<N>(id)) == EmptyNode)
+						return result;
+					return result + rank_node<N + 1>(id);
+				}
+			}
+
+			//逐层跳过计数不足 k 的子节点
+			template<index_t N>
+			int32_t select_node(index_t node, index_t k) const
 			{
-				std::array<flag_t, LayerCount - 1> nodes{};
-				std::array<index_t, LayerCount - 1> prefix{};
-				nodes[0] = vec.layer0();
-				index_t size = last(vec) + 1;
-				grow_to(size);
-				index_t level = 0;
-				if (nodes[0] == EmptyNode) return;
-				for (;;)
-				{
-					index_t low = lowbit_pos(nodes[level]);
-					nodes[level] &= ~(flag_t(1u) << low);
-					index_t id = prefix[level] | low;
-
-					++level;
-					if (level == 3)
+				flag_t children = _layers[N][node];
+				while (children != EmptyNode)
+				{
+					index_t low = lowbit_pos(children);
+					children = clear_lowbit(children);
+					index_t child = (node << BitsPerLayer) | low;
+					if constexpr (N + 1 == LeafLayer)
 					{
-						flag_t node = vec.layer3(id);
-						bubble_fill(id << BitsPerLayer);
-						_layer3[id] |= node;
-						do
+						flag_t word = _leaf[child];
+						index_t n = popcount(word);
+						if (k < n)
 						{
-							//root is empty, stop iterating
-							if (level == 0)
-								return;
-							--level;
-						} while (nodes[level] == EmptyNode);
+							for (; k > 0; --k)
+								word = clear_lowbit(word);
+							return (child << BitsPerLayer) | lowbit_pos(word);
+						}
+						k -= n;
 					}
 					else
 					{
-						nodes[level] = vec.layer(level, id);
-						prefix[level] = id << BitsPerLayer;
+						index_t n = _counts[N + 1][child];
+						if (k < n)
+							return select_node<N + 1>(child, k);
+						k -= n;
 					}
 				}
+				return -1;
 			}
 
-			//集合减(与非)
-			template<typename T>
-			void merge_sub(const T& vec)
+			//组合位数组的上层只保证是下层的超集,遇到空节点直接跳过
+			template<index_t N, typename T>
+			void merge_add_node(const T& vec, flag_t node, index_t prefix)
 			{
-				std::array<flag_t, LayerCount - 1> nodes{};
-				std::array<index_t, LayerCount - 1> prefix{};
-				nodes[0] = vec.layer0() & _layer0;
-				index_t level = 0;
-				if (nodes[0] == EmptyNode) return;
-				for (;;)
+				while (node != EmptyNode)
 				{
-					index_t low = lowbit_pos(nodes[level]);
-					nodes[level] &= ~(flag_t(1u) << low);
-					index_t id = prefix[level] | low;
-
-					++level;
-					if (level == 3)
+					index_t low = lowbit_pos(node);
+					node = clear_lowbit(node);
+					index_t id = prefix | low;
+					if constexpr (N + 1 == LeafLayer)
 					{
-						if (id >= _layer3.size()) return;
+						flag_t leaf = vec.template layer<LeafLayer>(id);
+						if (leaf == EmptyNode) continue;
+						bubble_fill(id << BitsPerLayer);
+						if constexpr (Counted)
+							add_count(id << BitsPerLayer, popcount(leaf & ~_leaf[id]));
+						_leaf[id] |= leaf;
+					}
+					else
+					{
+						merge_add_node<N + 1>(vec, vec.template layer<N + 1>(id), id << BitsPerLayer);
+					}
+				}
+			}
 
-						flag_t node = vec.layer3(id);
-						_layer3[id] &= ~node;
+			template<index_t N, typename T>
+			void merge_sub_node(const T& vec, flag_t node, index_t prefix)
+			{
+				while (node != EmptyNode)
+				{
+					index_t low = lowbit_pos(node);
+					node = clear_lowbit(node);
+					index_t id = prefix | low;
+					if constexpr (N + 1 == LeafLayer)
+					{
+						flag_t leaf = vec.template layer<LeafLayer>(id);
+						if (leaf == EmptyNode) continue;
+						if constexpr (Counted)
+							add_count(id << BitsPerLayer, index_t(0u) - popcount(leaf & _leaf[id]));
+						_leaf[id] &= ~leaf;
 						bubble_empty(id << BitsPerLayer);
-						do
-						{
-							//root is empty, stop iterating
-							if (level == 0)
-								return;
-							--level;
-						} while (nodes[level] == EmptyNode);
 					}
 					else
 					{
-						nodes[level] = vec.layer(level, id) & layer(level, id);
-						prefix[level] = id << BitsPerLayer;
+						merge_sub_node<N + 1>(vec, vec.template layer<N + 1>(id) & layer<N + 1>(id), id << BitsPerLayer);
 					}
 				}
 			}
-			
-			
-			
-		private:
+
+			//简单的尝试上浮空节点,直到遇到非空节点位置
 			void bubble_empty(index_t id)
 			{
-				//简单的尝试上浮空节点,直到遇到非空节点位置
-				index_t index_3 = index_of<3>(id);
-				if (_layer3[index_3] != EmptyNode) return;
-				index_t index_2 = index_of<2>(id);
-				_layer2[index_2] &= ~value_of<2>(id);
-				if (_layer2[index_2] != EmptyNode) return;
-				index_t index_1 = index_of<1>(id);
-				_layer1[index_1] &= ~value_of<1>(id);
-				if (_layer1[index_1] != EmptyNode) return;
-				_layer3.erase_block(index_2);
-				_layer0 &= ~value_of<0>(id);
+				if (_leaf[index_of<LeafLayer>(id)] != EmptyNode) return;
+				bubble_empty_node<LeafLayer - 1>(id);
+			}
+
+			template<index_t N>
+			void bubble_empty_node(index_t id)
+			{
+				flag_t& node = _layers[N][index_of<N>(id)];
+				node &= ~value_of<N>(id);
+				if (node != EmptyNode) return;
+				//block对应的节点为空,释放block
+				if constexpr (N + 1 == LeafLayer)
+					_leaf.erase_block(index_of<N>(id));
+				if constexpr (N > 0)
+					bubble_empty_node<N - 1>(id);
 			}
 
 			void bubble_fill(index_t id)
 			{
-				index_t index_3 = index_of<3>(id);
-				_layer3.try_add_block(index_of<2>(id));
-				if (_layer3[index_3] == EmptyNode)
+				index_t index = index_of<LeafLayer>(id);
+				_leaf.try_add_block(index_of<LeafLayer - 1>(id));
+				if (_leaf[index] == EmptyNode)
 				{
 					//直接修改父节点,1 | 1 = 1
-					_layer2[index_of<2>(id)] |= value_of<2>(id);
-					_layer1[index_of<1>(id)] |= value_of<1>(id);
-					_layer0 |= value_of<0>(id);
+					bubble_fill_nodes(id, std::make_index_sequence<LeafLayer>());
 				}
 			}
 
-			void set_range_true(index_t begin, index_t end)
+			template<std::size_t... Ns>
+			void bubble_fill_nodes(index_t id, std::index_sequence<Ns...>)
 			{
-				index_t startPos = begin;
-				index_t endPos = end - 1;
-
-				//范围设置可以直接覆盖父节点的边界
-				//主要需要注意的为范围在同一节点内的情况
+				((_layers[Ns][index_of<Ns>(id)] |= value_of<Ns>(id)), ...);
+			}
 
-				if (index_of<3>(startPos) == index_of<3>(endPos))
+			//在一层上设置子节点区间[begin, end]对应的位(闭区间)
+			template<index_t N>
+			void fill_bits(index_t begin, index_t end)
+			{
+				auto& layer = _layers[N];
+				index_t start = begin >> BitsPerLayer;
+				index_t stop = end >> BitsPerLayer;
+				if (start == stop)
 				{
-					_layer3.try_add_block(index_of<2>(startPos));
-					_layer3[index_of<3>(startPos)] |= (value_of<3>(endPos) - value_of<3>(startPos)) + value_of<3>(endPos);
+					layer[start] |= config::bits_between(begin & config::NodeMask, end & config::NodeMask);
 				}
 				else
 				{
-					index_t start = index_of<3>(startPos);
-					index_t end = index_of<3>(endPos);
-					if (start + 1 < end)
-						_layer3.fill(start + 1, end);
-					_layer3.try_add_block(index_of<2>(startPos));
-					_layer3.try_add_block(index_of<2>(endPos));
-					_layer3[start] |= FullNode - value_of<3>(startPos) + 1;
-					_layer3[end] |= (value_of<3>(endPos) - 1) + value_of<3>(endPos);
+					if (start + 1 < stop)
+						std::fill(&layer[start + 1], &layer[stop], FullNode);
+					layer[start] |= config::bits_between(begin & config::NodeMask, config::NodeMask);
+					layer[stop] |= config::bits_between(0, end & config::NodeMask);
 				}
+			}
 
-#define			SET_LAYER12(N) \
-				if (index_of<N>(startPos) == index_of<N>(endPos)) \
-				{ \
-					_layer##N[index_of<N>(startPos)] |= (value_of<N>(endPos) - value_of<N>(startPos)) + value_of<N>(endPos); \
-				} \
-				else \
-				{ \
-					index_t start = index_of<N>(startPos); \
-					index_t end = index_of<N>(endPos); \
-					if (start + 1 < end) \
-						std::fill(&_layer##N[start + 1], &_layer##N[end], FullNode); \
-					_layer##N[start] |= FullNode - value_of<N>(startPos) + 1; \
-					_layer##N[end] |= (value_of<N>(endPos) - 1) + value_of<N>(endPos); \
+			//在一层上清除子节点区间[begin, end]对应的位(闭区间)
+			template<index_t N>
+			void clear_bits(index_t begin, index_t end)
+			{
+				auto& layer = _layers[N];
+				index_t start = begin >> BitsPerLayer;
+				index_t stop = end >> BitsPerLayer;
+				if (start == stop)
+				{
+					layer[start] &= ~config::bits_between(begin & config::NodeMask, end & config::NodeMask);
 				}
+				else
+				{
+					if (start + 1 < stop)
+						std::fill(&layer[start + 1], &layer[stop], EmptyNode);
+					layer[start] &= ~config::bits_between(begin & config::NodeMask, config::NodeMask);
+					layer[stop] &= ~config::bits_between(0, end & config::NodeMask);
+				}
+			}
 
-				SET_LAYER12(2);
-				SET_LAYER12(1);
-
-				_layer0 |= (value_of<0>(endPos) - value_of<0>(startPos)) + value_of<0>(endPos);
-#undef		SET_LAYER12
+			template<std::size_t... Ns>
+			void fill_layers(index_t startPos, index_t endPos, std::index_sequence<Ns...>)
+			{
+				(fill_bits<Ns>(index_of<Ns + 1>(startPos), index_of<Ns + 1>(endPos)), ...);
 			}
 
-			void set_range_false(index_t begin, index_t end)
+			void set_range_true(index_t begin, index_t end)
 			{
 				index_t startPos = begin;
 				index_t endPos = end - 1;
-				//对于范围清零则要复杂得多,因为父节点的边界并不能直接清零
-				//而是需要先清零底层再进行冒泡
-				if (index_of<2>(startPos) == index_of<2>(endPos))
+
+				//范围设置可以直接覆盖父节点的边界
+				index_t start = index_of<LeafLayer>(startPos);
+				index_t stop = index_of<LeafLayer>(endPos);
+				_leaf.try_add_block(index_of<LeafLayer - 1>(startPos));
+				_leaf.try_add_block(index_of<LeafLayer - 1>(endPos));
+				if (start == stop)
 				{
-					if (value_of<2>(endPos) != value_of<2>(startPos))
-						_layer2[index_of<2>(startPos)] &= ~(value_of<2>(endPos) - value_of<2>(startPos) * 2);
+					_leaf[start] |= config::bits_between(startPos & config::NodeMask, endPos & config::NodeMask);
 				}
 				else
 				{
-					index_t start = index_of<2>(startPos);
-					index_t end = index_of<2>(endPos);
-					if (start + 1 < end)
-						std::fill(&_layer2[start + 1], &_layer2[end], EmptyNode);
-					_layer2[start] &= (value_of<2>(startPos) - 1) + value_of<2>(startPos);
-					_layer2[end] &= FullNode - value_of<2>(endPos) + 1;
+					_leaf.fill(start + 1, stop);
+					_leaf[start] |= config::bits_between(startPos & config::NodeMask, config::NodeMask);
+					_leaf[stop] |= config::bits_between(0, endPos & config::NodeMask);
 				}
+				fill_layers(startPos, endPos, std::make_index_sequence<LeafLayer>());
+			}
 
-				if (index_of<1>(startPos) == index_of<1>(endPos))
+			//对于范围清零则要复杂得多,因为父节点的边界并不能直接清零
+			//而是需要自底向上,只有边界上的子节点为空时才清除对应的位
+			template<index_t N>
+			void clear_layer(index_t startPos, index_t endPos, bool startEmpty, bool endEmpty)
+			{
+				//完全被覆盖的子节点必然为空,边界上的子节点视情况而定
+				index_t begin = index_of<N + 1>(startPos);
+				index_t end = index_of<N + 1>(endPos);
+				if (begin == end)
 				{
-					if (value_of<1>(endPos) != value_of<1>(startPos))
-						_layer1[index_of<1>(startPos)] &= ~(value_of<1>(endPos) - value_of<1>(startPos) * 2);
+					if (startEmpty)
+						clear_bits<N>(begin, end);
 				}
 				else
 				{
-					index_t start = index_of<1>(startPos);
-					index_t end = index_of<1>(endPos);
-					if (start + 1 < end)
-						std::fill(&_layer1[start + 1], &_layer1[end], EmptyNode);
-					_layer1[start] &= (value_of<1>(startPos) - 1) + value_of<1>(startPos);
-					_layer1[end] &= FullNode - value_of<1>(endPos) + 1;
+					index_t lo = startEmpty ? begin : begin + 1;
+					index_t hi = endEmpty ? end : end - 1;
+					if (lo <= hi)
+						clear_bits<N>(lo, hi);
+				}
+				index_t start = index_of<N>(startPos);
+				index_t stop = index_of<N>(endPos);
+				if constexpr (N + 1 == LeafLayer)
+				{
+					if (_layers[N][start] == EmptyNode)
+						_leaf.try_erase_block(start);
+					if (_layers[N][stop] == EmptyNode)
+						_leaf.try_erase_block(stop);
 				}
+				if constexpr (N > 0)
+					clear_layer<N - 1>(startPos, endPos, _layers[N][start] == EmptyNode, _layers[N][stop] == EmptyNode);
+			}
 
-				if (index_of<3>(startPos) == index_of<3>(endPos) && _layer3.valid(index_of<3>(startPos)))
+			void set_range_false(index_t begin, index_t end)
+			{
+				index_t startPos = begin;
+				index_t endPos = end - 1;
+				index_t start = index_of<LeafLayer>(startPos);
+				index_t stop = index_of<LeafLayer>(endPos);
+				if (start == stop)
 				{
-					_layer3[index_of<3>(startPos)] &= ~((value_of<3>(endPos) - value_of<3>(startPos)) + value_of<3>(endPos));
-					bubble_empty(startPos);
+					if (_leaf.valid(start))
+						_leaf[start] &= ~config::bits_between(startPos & config::NodeMask, endPos & config::NodeMask);
 				}
 				else
 				{
-					index_t start = index_of<3>(startPos);
-					index_t end = index_of<3>(endPos);
-					if (start + 1 < end)
-						_layer3.reset(start + 1, end);
-					if (_layer3.valid(start))
-					{
-						_layer3[start] &= ~(FullNode - value_of<3>(startPos) + 1);
-						bubble_empty(startPos);
-					}
-					if (_layer3.valid(end))
-					{
-						_layer3[end] &= ~((value_of<3>(endPos) - 1) + value_of<3>(endPos));
-						bubble_empty(endPos);
-					}
+					_leaf.reset(start + 1, stop);
+					if (_leaf.valid(start))
+						_leaf[start] &= ~config::bits_between(startPos & config::NodeMask, config::NodeMask);
+					if (_leaf.valid(stop))
+						_leaf[stop] &= ~config::bits_between(0, endPos & config::NodeMask);
 				}
-				_layer0 &= ~((value_of<0>(endPos) - value_of<0>(startPos)) + value_of<0>(endPos));
+				clear_layer<LeafLayer - 1>(startPos, endPos, layer<LeafLayer>(start) == EmptyNode, layer<LeafLayer>(stop) == EmptyNode);
 			}
 		};
 
+		//默认的分层位数组,4层64位节点,最大支持 2^24 个位
+		using hbv = basic_hbv<>;
+		//3层,最大支持 2^18 个位,上层节点可以完全放入L1
+		using small_hbv = basic_hbv<3u>;
+		//5层,最大支持 2^30 个位
+		using large_hbv = basic_hbv<5u>;
+		//维护计数的默认分层位数组
+		using counted_hbv = basic_hbv<4u, flag_t, true>;
+
 		/*
-		复合分层位数组(Compound Hierarchical Bit Vector),编译期惰性的在数组间应用函数,在查询时真正执行合并
+		并发分层位数组,多个线程可以同时设置和清除标志位(无锁)
+		容量在构造时确定,不会扩容;最底层的 block 按需分配并通过 CAS 发布,竞争失败的一方释放自己的 block
+		置位时先 fetch_or 最底层,节点由空变为非空的线程再逐层向上 fetch_or(父节点已置位则说明已有线程负责上浮)
+		清除只 fetch_and 最底层,上层保持为超集(与组合位数组相同,遍历时会回溯),因此置位和清除之间不会丢失上层的标志位
+		写入全部结束后(如 parallel_for 返回后)可以被 for_each 和组合位数组读取,也可以 merge_add 到普通的 hbv 中
+		tidy 清除上层多余的标志位并释放空的 block,clear 清空,两者都不能与写入并发
 		*/
-		template<typename F, typename... Ts>
-		class chbv
+		template<index_t Layers = 4u, typename Flag = flag_t>
+		class basic_atomic_hbv final
 		{
-			template<typename T>
-			struct storage { using type = T; };
-			template<>
-			struct storage<hbv> { using type = const hbv&; };
-			template<typename T>
-			using storage_t = typename storage<T>::type;
-			const std::tuple<storage_t<Ts>...> _nodes;
-			F op = {};
 		public:
-			template<typename... Ts>
-			chbv(Ts&&... args) : _nodes(std::forward<Ts>(args)...) {}
+			using config = hbv_config<Layers, Flag>;
+			using flag_t = typename config::flag_t;
+		private:
+			static constexpr index_t BitsPerLayer = config::BitsPerLayer;
+			static constexpr index_t LeafLayer = config::LeafLayer;
+			static constexpr index_t BlockWords = 1u << BitsPerLayer;
+			static constexpr flag_t EmptyNode = config::EmptyNode;
+			template<index_t layer>
+			static constexpr index_t index_of(index_t id) noexcept { return config::template index_of<layer>(id); }
+			template<index_t layer>
+			static constexpr flag_t value_of(index_t id) noexcept { return config::template value_of<layer>(id); }
+
+			using node_t = std::atomic<flag_t>;
+			//上层节点,_layers[LeafLayer - 1] 的每个节点对应一个 block
+			std::array<std::unique_ptr<node_t[]>, LeafLayer> _layers;
+			std::array<index_t, LeafLayer> _layerSizes;
+			std::unique_ptr<std::atomic<node_t*>[]> _blocks;
+			index_t _size;
+
+			node_t* block(index_t b) const noexcept
+			{
+				return _blocks[b].load(std::memory_order_acquire);
+			}
 
-			flag_t layer0() const noexcept
+			node_t* acquire_block(index_t b)
+			{
+				node_t* current = block(b);
+				if (current != nullptr)
+					return current;
+				//值初始化即清零
+				node_t* fresh = new node_t[BlockWords]();
+				if (_blocks[b].compare_exchange_strong(current, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+					return fresh;
+				delete[] fresh;
+				return current;
+			}
+
+			template<index_t N>
+			void bubble_fill(index_t id) noexcept
+			{
+				node_t& node = _layers[N][index_of<N>(id)];
+				flag_t bit = value_of<N>(id);
+				if ((node.load(std::memory_order_relaxed) & bit) != EmptyNode)
+					return;
+				if ((node.fetch_or(bit, std::memory_order_relaxed) & bit) != EmptyNode)
+					return;
+				if constexpr (N > 0)
+					bubble_fill<N - 1>(id);
+			}
+
+			//由下一层重新计算第 N 层
+			template<index_t N>
+			void tidy_layer() noexcept
+			{
+				for (index_t i = 0; i < _layerSizes[N]; ++i)
+				{
+					flag_t node = EmptyNode;
+					index_t first = i << BitsPerLayer;
+					index_t count = std::min(BlockWords, _layerSizes[N + 1] - first);
+					for (index_t c = 0; c < count; ++c)
+						if (_layers[N + 1][first + c].load(std::memory_order_relaxed) != EmptyNode)
+							node |= flag_t(1) << c;
+					_layers[N][i].store(node, std::memory_order_relaxed);
+				}
+				if constexpr (N > 0)
+					tidy_layer<N - 1>();
+			}
+
+		public:
+			explicit basic_atomic_hbv(index_t max = 10)
+			{
+				_size = std::min(std::max(max, 1u), config::MaxSize);
+				index_t last = _size - 1u;
+				init_layers(last, std::make_index_sequence<LeafLayer>());
+				_blocks.reset(new std::atomic<node_t*>[_layerSizes[LeafLayer - 1]]());
+			}
+
+			~basic_atomic_hbv()
+			{
+				clear_blocks();
+			}
+
+			basic_atomic_hbv(const basic_atomic_hbv&) = delete;
+			basic_atomic_hbv& operator=(const basic_atomic_hbv&) = delete;
+
+			//容量,下标必须小于容量
+			index_t size() const noexcept
 			{
-				return compose_layer0(std::make_index_sequence<sizeof...(Ts)>());
+				return _size;
 			}
 
-			flag_t layer1(index_t id) const noexcept
+			//对第 word 个最底层节点原子的按位或,返回原来的值
+			flag_t fetch_or(index_t word, flag_t bits)
 			{
-				return compose_layer1(id, std::make_index_sequence<sizeof...(Ts)>());
+				node_t* words = acquire_block(word >> BitsPerLayer);
+				flag_t old = words[word & config::NodeMask].fetch_or(bits, std::memory_order_relaxed);
+				if (old == EmptyNode && bits != EmptyNode)
+					bubble_fill<LeafLayer - 1>(word << BitsPerLayer);
+				return old;
 			}
 
-			flag_t layer2(index_t id) const noexcept
+			//对第 word 个最底层节点原子的按位与,返回原来的值
+			flag_t fetch_and(index_t word, flag_t bits) noexcept
 			{
-				return compose_layer2(id, std::make_index_sequence<sizeof...(Ts)>());
+				node_t* words = block(word >> BitsPerLayer);
+				if (words == nullptr)
+					return EmptyNode;
+				return words[word & config::NodeMask].fetch_and(bits, std::memory_order_relaxed);
 			}
 
-			flag_t layer3(index_t id) const noexcept
+			//设置标志位,返回原来的值
+			bool set(index_t id, bool value)
 			{
-				return compose_layer3(id, std::make_index_sequence<sizeof...(Ts)>());
+				index_t word = index_of<LeafLayer>(id);
+				flag_t bit = value_of<LeafLayer>(id);
+				flag_t old = value ? fetch_or(word, bit) : fetch_and(word, ~bit);
+				return (old & bit) != EmptyNode;
+			}
+
+			bool test(index_t id) const noexcept
+			{
+				return (layer<LeafLayer>(index_of<LeafLayer>(id)) & value_of<LeafLayer>(id)) != EmptyNode;
 			}
 
 			bool contain(index_t id) const noexcept
 			{
-				return compose_contain(id, std::make_index_sequence<sizeof...(Ts)>());
+				return test(id);
+			}
+
+			flag_t layer0() const noexcept
+			{
+				return _layers[0][0].load(std::memory_order_relaxed);
+			}
+
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
+			{
+				if constexpr (N == LeafLayer)
+				{
+					index_t b = id >> BitsPerLayer;
+					if (b >= _layerSizes[LeafLayer - 1])
+						return EmptyNode;
+					node_t* words = block(b);
+					return words == nullptr ? EmptyNode : words[id & config::NodeMask].load(std::memory_order_relaxed);
+				}
+				else
+				{
+					if (id >= _layerSizes[N])
+						return EmptyNode;
+					return _layers[N][id].load(std::memory_order_relaxed);
+				}
 			}
 
 			flag_t layer(index_t level, index_t id) const noexcept
 			{
-				switch (level)
+				return dispatch_layer(*this, level, id, std::make_index_sequence<Layers>());
+			}
+
+			//清除上层多余的标志位并释放空的 block,不能与写入并发
+			void tidy() noexcept
+			{
+				for (index_t b = 0; b < _layerSizes[LeafLayer - 1]; ++b)
 				{
-				case 0:
-					return layer0();
-				case 1:
-					return layer1(id);
-				case 2:
-					return layer2(id);
-				case 3:
-					return layer3(id);
-				default:
-					return 0;
+					node_t* words = block(b);
+					flag_t node = EmptyNode;
+					if (words != nullptr)
+					{
+						for (index_t i = 0; i < BlockWords; ++i)
+							if (words[i].load(std::memory_order_relaxed) != EmptyNode)
+								node |= flag_t(1) << i;
+						if (node == EmptyNode)
+						{
+							delete[] words;
+							_blocks[b].store(nullptr, std::memory_order_relaxed);
+						}
+					}
+					_layers[LeafLayer - 1][b].store(node, std::memory_order_relaxed);
 				}
+				if constexpr (LeafLayer > 1)
+					tidy_layer<LeafLayer - 2>();
+			}
+
+			//清空位数组,不能与写入并发
+			void clear() noexcept
+			{
+				clear_blocks();
+				for (index_t n = 0; n < LeafLayer; ++n)
+					for (index_t i = 0; i < _layerSizes[n]; ++i)
+						_layers[n][i].store(EmptyNode, std::memory_order_relaxed);
 			}
+
 		private:
+			template<std::size_t... Ns>
+			void init_layers(index_t last, std::index_sequence<Ns...>)
+			{
+				((_layerSizes[Ns] = index_of<Ns>(last) + 1u, _layers[Ns].reset(new node_t[_layerSizes[Ns]]())), ...);
+			}
 
-			template<index_t... i>
-			flag_t compose_layer0(std::index_sequence<i...>) const noexcept
+			void clear_blocks() noexcept
 			{
-				return op(std::get<i>(_nodes).layer0()...);
+				for (index_t b = 0; b < _layerSizes[LeafLayer - 1]; ++b)
+				{
+					delete[] block(b);
+					_blocks[b].store(nullptr, std::memory_order_relaxed);
+				}
 			}
+		};
+
+		//默认的并发分层位数组,最大支持 2^24 个位
+		using atomic_hbv = basic_atomic_hbv<>;
+
+		template<typename T>
+		struct is_hbv : std::false_type {};
+		template<index_t Layers, typename Flag, bool Counted, template<std::size_t> class Allocator>
+		struct is_hbv<basic_hbv<Layers, Flag, Counted, Allocator>> : std::true_type {};
+		//并发位数组不可复制,组合时同样引用
+		template<index_t Layers, typename Flag>
+		struct is_hbv<basic_atomic_hbv<Layers, Flag>> : std::true_type {};
+
+		template<typename T>
+		struct is_counted_hbv : std::false_type {};
+		template<index_t Layers, typename Flag, template<std::size_t> class Allocator>
+		struct is_counted_hbv<basic_hbv<Layers, Flag, true, Allocator>> : std::true_type {};
+
+		//组合时直接引用位数组,组合位数组则复制(本身只有引用)
+		template<typename T>
+		using storage_t = std::conditional_t<is_hbv<T>::value, const T&, T>;
 
-			template<index_t... i>
-			flag_t compose_layer1(index_t id, std::index_sequence<i...>) const noexcept
+		/*
+		复合分层位数组(Compound Hierarchical Bit Vector),编译期惰性的在数组间应用函数,在查询时真正执行合并
+		*/
+		template<typename F, typename T, typename... Ts>
+		class chbv
+		{
+			const std::tuple<storage_t<T>, storage_t<Ts>...> _nodes;
+			F op = {};
+		public:
+			using config = typename T::config;
+			using flag_t = typename config::flag_t;
+			static_assert(std::conjunction_v<std::is_same<config, typename Ts::config>...>, "can't compose hbv with different config");
+
+			template<typename... Args>
+			chbv(Args&&... args) : _nodes(std::forward<Args>(args)...) {}
+
+			flag_t layer0() const noexcept
 			{
-				return op(std::get<i>(_nodes).layer1(id)...);
+				return layer<0>(0);
 			}
 
-			template<index_t... i>
-			flag_t compose_layer2(index_t id, std::index_sequence<i...>) const noexcept
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
+			{
+				return compose_layer<N>(id, std::make_index_sequence<sizeof...(Ts) + 1>());
+			}
+
+			flag_t layer(index_t level, index_t id) const noexcept
 			{
-				return op(std::get<i>(_nodes).layer2(id)...);
+				return dispatch_layer(*this, level, id, std::make_index_sequence<config::LayerCount>());
 			}
 
-			template<index_t... i>
-			flag_t compose_layer3(index_t id, std::index_sequence<i...>) const noexcept
+			bool contain(index_t id) const noexcept
+			{
+				return compose_contain(id, std::make_index_sequence<sizeof...(Ts) + 1>());
+			}
+		private:
+			template<index_t N, std::size_t... i>
+			flag_t compose_layer(index_t id, std::index_sequence<i...>) const noexcept
 			{
-				return op(std::get<i>(_nodes).layer3(id)...);
+				return op(std::get<i>(_nodes).template layer<N>(id)...);
 			}
 
-			template<index_t... i>
+			template<std::size_t... i>
 			bool compose_contain(index_t id, std::index_sequence<i...>) const noexcept
 			{
 				return op(std::get<i>(_nodes).contain(id)...);
@@ -644,19 +1369,19 @@ namespace common
 
 		struct and_op_t
 		{
-			template<typename... Ts>
-			flag_t operator()(Ts... args) const
+			template<typename T, typename... Ts>
+			T operator()(T arg, Ts... args) const
 			{
-				return (args & ...);
+				return (arg & ... & args);
 			}
 		};
 
 		struct or_op_t
 		{
-			template<typename... Ts>
-			flag_t operator()(Ts... args) const
+			template<typename T, typename... Ts>
+			T operator()(T arg, Ts... args) const
 			{
-				return (args | ...);
+				return (arg | ... | args);
 			}
 		};
 
@@ -665,156 +1390,469 @@ namespace common
 		/*
 		组合位数组的取反版本
 		注意因为分层位数组的算法原理并不支持非操作, 此方法会使得分层位数组退化为普通位数组(慢!
+		排除查询请使用 chbv_andnot
 		*/
 		template<typename T>
 		class chbv_not
 		{
-			template<typename T>
-			struct storage { using type = T; };
+			storage_t<T> _node;
+		public:
+			using config = typename T::config;
+			using flag_t = typename config::flag_t;
 
-			template<>
-			struct storage<hbv> { using type = const hbv&; };
+			template<typename X>
+			chbv_not(X&& arg) : _node(std::forward<X>(arg)) { }
 
-			template<typename T>
-			using storage_t = typename storage<T>::type;
+			flag_t layer0() const noexcept
+			{
+				return config::FullNode;
+			}
+
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
+			{
+				if constexpr (N == config::LeafLayer)
+					return ~_node.template layer<N>(id);
+				else
+					return config::FullNode;
+			}
 
+			flag_t layer(index_t level, index_t id) const noexcept
+			{
+				return dispatch_layer(*this, level, id, std::make_index_sequence<config::LayerCount>());
+			}
+
+			bool contain(index_t id) const noexcept
+			{
+				return !_node.contain(id);
+			}
+		};
+
+		/*
+		组合位数组的与非版本(A & ~B)
+		上层直接沿用A的上层,是结果的超集但保持了分层结构,遍历时仍然可以跳过A中的连续空位
+		只有最底层真正计算A & ~B,组合后为空的节点在遍历时被跳过
+		*/
+		template<typename T, typename U>
+		class chbv_andnot
+		{
 			storage_t<T> _node;
+			storage_t<U> _exclude;
 		public:
-			template<typename T>
-			chbv_not(T&& arg) : _node(std::forward<T>(arg)) { }
+			using config = typename T::config;
+			using flag_t = typename config::flag_t;
+			static_assert(std::is_same_v<config, typename U::config>, "can't compose hbv with different config");
+
+			template<typename A, typename B>
+			chbv_andnot(A&& arg, B&& exclude) : _node(std::forward<A>(arg)), _exclude(std::forward<B>(exclude)) { }
 
 			flag_t layer0() const noexcept
 			{
-				return FullNode;
+				return _node.layer0();
 			}
 
-			flag_t layer1(index_t id) const noexcept
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
 			{
-				return FullNode;
+				if constexpr (N == config::LeafLayer)
+				{
+					flag_t node = _node.template layer<N>(id);
+					//A中为空则不需要读B
+					return node == config::EmptyNode ? node : node & ~_exclude.template layer<N>(id);
+				}
+				else
+					return _node.template layer<N>(id);
 			}
 
-			flag_t layer2(index_t id) const noexcept
+			flag_t layer(index_t level, index_t id) const noexcept
 			{
-				return FullNode;
+				return dispatch_layer(*this, level, id, std::make_index_sequence<config::LayerCount>());
 			}
 
-			flag_t layer3(index_t id) const noexcept
+			bool contain(index_t id) const noexcept
 			{
-				return ~_node.layer3(id);
+				return _node.contain(id) && !_exclude.contain(id);
 			}
+		};
 
-			bool contain(index_t id) const noexcept
+		//组合位数组的上层可能是下层的超集,因此下降到空节点时需要回溯
+		template<index_t N, index_t Level, typename T>
+		int32_t last_node(const T& vec, typename T::flag_t node, index_t prefix) noexcept
+		{
+			constexpr index_t bits = T::config::BitsPerLayer;
+			while (node != T::config::EmptyNode)
 			{
-				return ~_node.contain(id);
+				index_t high = highbit_pos(node);
+				node &= ~(typename T::flag_t(1u) << high);
+				index_t id = prefix | high;
+				if constexpr (N == Level)
+					return id;
+				else
+				{
+					int32_t result = last_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << bits);
+					if (result != -1)
+						return result;
+				}
 			}
+			return -1;
+		}
 
-			flag_t layer(index_t level, index_t id) const noexcept
+		template<index_t N, index_t Level, typename T>
+		int32_t first_node(const T& vec, typename T::flag_t node, index_t prefix) noexcept
+		{
+			constexpr index_t bits = T::config::BitsPerLayer;
+			while (node != T::config::EmptyNode)
 			{
-				switch (level)
+				index_t low = lowbit_pos(node);
+				node = clear_lowbit(node);
+				index_t id = prefix | low;
+				if constexpr (N == Level)
+					return id;
+				else
 				{
-				case 0:
-					return layer0();
-				case 1:
-					return layer1(id);
-				case 2:
-					return layer2(id);
-				case 3:
-					return layer3(id);
-				default:
-					return 0;
+					int32_t result = first_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << bits);
+					if (result != -1)
+						return result;
 				}
 			}
-		};
+			return -1;
+		}
 
-		
+		template<index_t N, index_t Level, typename T, typename F>
+		__forceinline void for_each_node(const T& vec, typename T::flag_t node, index_t prefix, const F& f) noexcept
+		{
+			constexpr index_t bits = T::config::BitsPerLayer;
+			//子节点遍历完(或组合后为空),回到上层节点
+			while (node != T::config::EmptyNode)
+			{
+				//遍历节点
+				index_t low = lowbit_pos(node);
+				node = clear_lowbit(node);
+				index_t id = prefix | low;
+				if constexpr (N == Level)
+					f(id);
+				else //上层节点,遍历子节点
+					for_each_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << bits, f);
+			}
+		}
 
-		//取得位数组(或组合位数组)的第一个标志位
-		template<index_t Level = 3, typename T>
+		//取得位数组(或组合位数组)的最后一个标志位
+		template<index_t Level = LeafLevel, typename T>
 		int32_t last(const T& vec) noexcept
 		{
-			flag_t nodes{};
-			nodes = vec.layer0();
-			if (nodes == EmptyNode) return -1;
-			index_t id{};
+			return last_node<0, level_of<T, Level>>(vec, vec.layer0(), 0);
+		}
+
+		//取得位数组(或组合位数组)的第一个标志位
+		template<index_t Level = LeafLevel, typename T>
+		int32_t first(const T& vec) noexcept
+		{
+			return first_node<0, level_of<T, Level>>(vec, vec.layer0(), 0);
+		}
+
+		//遍历位数组(或组合位数组),Level 指定遍历到哪一层(得到的是下一层节点的下标),默认为最底层
+		template<index_t Level = LeafLevel, typename T, typename F>
+		void for_each(const T& vec, const F& f) noexcept
+		{
+			for_each_node<0, level_of<T, Level>>(vec, vec.layer0(), 0, f);
+		}
 
-			for (int32_t level = 0;; ++level)
+		template<index_t N, index_t Level, typename T, typename F>
+		__forceinline void for_each_range_node(const T& vec, typename T::flag_t node, index_t prefix, index_t begin, index_t end, const F& f) noexcept
+		{
+			using config = typename T::config;
+			//裁剪出与[begin, end]相交的子节点
+			index_t lo = config::template index_of<N + 1>(begin);
+			index_t hi = config::template index_of<N + 1>(end);
+			index_t first = prefix;
+			index_t last = prefix | config::NodeMask;
+			if (lo > first)
+				node &= config::bits_between(lo & config::NodeMask, config::NodeMask);
+			if (hi < last)
+				node &= config::bits_between(0, hi & config::NodeMask);
+			while (node != config::EmptyNode)
 			{
-				index_t high = highbit_pos(nodes);
-				id |= high;
-				if (level >= Level)
-					return id;
-				id <<= BitsPerLayer;
-				nodes = vec.layer(level + 1, id);
+				index_t low = lowbit_pos(node);
+				node = clear_lowbit(node);
+				index_t id = prefix | low;
+				if constexpr (N == Level)
+					f(id);
+				else if (id == lo || id == hi) //只有边界上的子节点需要继续裁剪
+					for_each_range_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << config::BitsPerLayer, begin, end, f);
+				else
+					for_each_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << config::BitsPerLayer, f);
 			}
 		}
 
-		//取得位数组(或组合位数组)的最后一个标志位
-		template<index_t Level = 3, typename T>
-		int32_t first(const T& vec) noexcept
+		//遍历位数组(或组合位数组)在[begin, end)内的标志位
+		template<typename T, typename F>
+		void for_each(const T& vec, index_t begin, index_t end, const F& f) noexcept
 		{
-			flag_t nodes{};
-			nodes = vec.layer0();
-			if (nodes == EmptyNode) return -1;
-			index_t id{};
+			if (begin >= end) return;
+			for_each_range_node<0, T::config::LeafLayer>(vec, vec.layer0(), 0, begin, end - 1, f);
+		}
 
-			for (int32_t level = 0;; ++level)
+		template<index_t N, index_t Level, typename T>
+		int32_t first_range_node(const T& vec, typename T::flag_t node, index_t prefix, index_t begin, index_t end) noexcept
+		{
+			using config = typename T::config;
+			index_t lo = config::template index_of<N + 1>(begin);
+			index_t hi = config::template index_of<N + 1>(end);
+			if (lo > prefix)
+				node &= config::bits_between(lo & config::NodeMask, config::NodeMask);
+			if (hi < (prefix | config::NodeMask))
+				node &= config::bits_between(0, hi & config::NodeMask);
+			while (node != config::EmptyNode)
 			{
-				index_t high = lowbit_pos(nodes);
-				id |= high;
-				if (level >= Level)
+				index_t low = lowbit_pos(node);
+				node = clear_lowbit(node);
+				index_t id = prefix | low;
+				if constexpr (N == Level)
 					return id;
-				id <<= BitsPerLayer;
-				nodes = vec.layer(level + 1, id);
+				else
+				{
+					int32_t result = (id == lo || id == hi)
+						? first_range_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << config::BitsPerLayer, begin, end)
+						: first_node<N + 1, Level>(vec, vec.template layer<N + 1>(id), id << config::BitsPerLayer);
+					if (result != -1)
+						return result;
+				}
 			}
+			return -1;
 		}
 
-		//遍历位数组(或组合位数组)
-		template<index_t Level = 3, typename T, typename F>
-		void for_each(const T& vec, const F& f) noexcept
+		//取得位数组(或组合位数组)在[begin, end)内的第一个标志位,没有时返回 -1
+		template<typename T>
+		int32_t first(const T& vec, index_t begin, index_t end) noexcept
+		{
+			if (begin >= end) return -1;
+			return first_range_node<0, T::config::LeafLayer>(vec, vec.layer0(), 0, begin, end - 1);
+		}
+
+		//合并连续的区间,区间相接时延长,否则把之前的区间交给函数
+		template<typename F>
+		struct run_builder
 		{
-			std::array<flag_t, Level + 1> nodes{};
-			std::array<index_t, Level + 1> prefix{};
-			nodes[0] = vec.layer0();
-			index_t level = 0;
-			if (nodes[0] == EmptyNode) return;
+			const F& f;
+			//只输出 [lower, upper) 内的部分
+			index_t lower = 0;
+			index_t upper = ~index_t(0u);
+			index_t begin = 0;
+			index_t end = 0;
+
+			__forceinline void add(index_t first, index_t last)
+			{
+				first = std::max(first, lower);
+				last = std::min(last, upper);
+				if (first >= last)
+					return;
+				if (first != end || begin == end)
+				{
+					if (begin != end)
+						f(begin, end);
+					begin = first;
+				}
+				end = last;
+			}
 
-			while (true)
+			__forceinline void flush()
 			{
-				//遍历节点
-				index_t low = lowbit_pos(nodes[level]);
-				nodes[level] &= ~(flag_t(1u) << low);
-				index_t id = prefix[level] | low;
-				//上层节点,遍历子节点
-				if (level < Level)
+				if (begin != end)
+					f(begin, end);
+			}
+		};
+
+		template<index_t N, typename T, typename F>
+		__forceinline void for_each_run_node(const T& vec, typename T::flag_t node, index_t prefix, run_builder<F>& runs) noexcept
+		{
+			using config = typename T::config;
+			using uflag_t = typename config::uflag_t;
+			constexpr index_t bits = config::BitsPerLayer;
+			constexpr index_t span = (config::LayerCount - N - 1) * bits;
+			while (node != config::EmptyNode)
+			{
+				index_t low = lowbit_pos(node);
+				node = clear_lowbit(node);
+				index_t id = prefix | low;
+				//跳过范围之外的子树,子树按升序访问,超过上界即可结束
+				if ((id << span) >= runs.upper)
+					return;
+				if (((id + 1) << span) <= runs.lower)
+					continue;
+				if constexpr (N + 1 == config::LeafLayer)
 				{
-					++level;
-					nodes[level] = vec.layer(level, id);
-					prefix[level] = id << BitsPerLayer;
+					auto word = vec.template layer<config::LeafLayer>(id);
+					index_t base = id << bits;
+					//整个节点都是标志位,直接延长
+					if (word == config::FullNode)
+					{
+						runs.add(base, base + (1u << bits));
+						continue;
+					}
+					while (word != config::EmptyNode)
+					{
+						index_t start = lowbit_pos(word);
+						//从 start 开始的连续标志位
+						uflag_t rest = ~uflag_t(word) & (~uflag_t(0u) << start);
+						index_t stop = rest == 0u ? (1u << bits) : lowbit_pos(rest);
+						runs.add(base + start, base + stop);
+						word &= ~config::bits_between(start, stop - 1);
+					}
 				}
 				else
 				{
-					f(id);
-					//子节点遍历完,回到上层节点
-					while (nodes[level] == EmptyNode)
+					//维护计数的位数组可以直接识别全满的子树
+					if constexpr (is_counted_hbv<T>::value)
 					{
-						//直到Layer0被遍历完
-						if (level == 0)
-							return;
-						--level;
+						if (vec.template population<N + 1>(id) == (1u << span))
+						{
+							runs.add(id << span, (id + 1) << span);
+							continue;
+						}
 					}
+					for_each_run_node<N + 1>(vec, vec.template layer<N + 1>(id), id << bits, runs);
+				}
+			}
+		}
+
+		//按连续区间遍历位数组(或组合位数组),函数参数为[begin, end)
+		//适合 range_set 或 batch_create 产生的连续下标,每个区间只调用一次函数
+		template<typename T, typename F>
+		void for_each_run(const T& vec, const F& f) noexcept
+		{
+			run_builder<F> runs{ f };
+			for_each_run_node<0>(vec, vec.layer0(), 0, runs);
+			runs.flush();
+		}
+
+		//按连续区间遍历 [begin, end) 内的部分,区间会在边界处截断,范围之外的子树不会访问
+		template<typename T, typename F>
+		void for_each_run(const T& vec, index_t begin, index_t end, const F& f) noexcept
+		{
+			if (begin >= end)
+				return;
+			run_builder<F> runs{ f, begin, end };
+			for_each_run_node<0>(vec, vec.layer0(), 0, runs);
+			runs.flush();
+		}
+
+		//按最底层节点遍历位数组(或组合位数组),函数参数为(节点第一个位的下标, 节点)
+		//只对非空的节点调用,节点的第 i 位对应下标 base + i,适合配合掩码做 SIMD 处理
+		template<typename T, typename F>
+		void for_each_word(const T& vec, const F& f) noexcept
+		{
+			using config = typename T::config;
+			for_each<config::LeafLayer - 1>(vec, [&vec, &f](index_t id)
+			{
+				auto word = vec.template layer<config::LeafLayer>(id);
+				//组合位数组的上层节点可能多于实际结果
+				if (word != config::EmptyNode)
+					f(id << config::BitsPerLayer, word);
+			});
+		}
+
+		//取得位数组(或组合位数组)的标志位数量
+		//维护计数的位数组为 O(1),其他情况只遍历到最底层的节点并统计位数,而不是逐位遍历
+		template<typename T>
+		index_t count(const T& vec) noexcept
+		{
+			if constexpr (is_counted_hbv<T>::value)
+				return vec.count();
+			else
+			{
+				using config = typename T::config;
+				index_t result = 0;
+				for_each<config::LeafLayer - 1>(vec, [&vec, &result](index_t id)
+				{
+					result += popcount(vec.template layer<config::LeafLayer>(id));
+				});
+				return result;
+			}
+		}
+
+		//快速估计标志位数量的上界,只读到倒数第二层:每个非空的最底层节点按全满计算
+		//维护计数的位数组直接返回准确值,组合位数组的上层是超集,结果同样是上界
+		template<typename T>
+		index_t estimate(const T& vec) noexcept
+		{
+			if constexpr (is_counted_hbv<T>::value)
+				return vec.count();
+			else
+			{
+				using config = typename T::config;
+				//两层时倒数第二层就是根节点
+				if constexpr (config::LeafLayer == 1u)
+					return index_t(popcount(vec.layer0())) << config::BitsPerLayer;
+				else
+				{
+					index_t words = 0;
+					for_each<config::LeafLayer - 2>(vec, [&vec, &words](index_t id)
+					{
+						words += popcount(vec.template layer<config::LeafLayer - 1>(id));
+					});
+					return words << config::BitsPerLayer;
 				}
 			}
 		}
 
-		//组合位数组
+		/*
+		把位数组(或组合位数组)切分为 n 段标志位数量接近的区间,返回 n + 1 个边界
+		第 i 段为[bounds[i], bounds[i + 1])
+		维护计数的位数组直接使用 select,其他情况以最底层节点为粒度切分
+		*/
+		template<typename T>
+		std::vector<index_t> split(const T& vec, index_t n)
+		{
+			using config = typename T::config;
+			std::vector<index_t> bounds;
+			bounds.reserve(n + 1);
+			bounds.push_back(0);
+			index_t total = count(vec);
+			if (total == 0 || n == 0)
+			{
+				bounds.push_back(0);
+				return bounds;
+			}
+			index_t end = last(vec) + 1;
+			if constexpr (is_counted_hbv<T>::value)
+			{
+				for (index_t i = 1; i < n; ++i)
+				{
+					index_t bound = vec.select(index_t(uint64_t(total) * i / n));
+					if (bound > bounds.back())
+						bounds.push_back(bound);
+				}
+			}
+			else
+			{
+				index_t acc = 0;
+				index_t i = 1;
+				for_each<config::LeafLayer - 1>(vec, [&](index_t id)
+				{
+					acc += popcount(vec.template layer<config::LeafLayer>(id));
+					if (i < n && acc >= index_t(uint64_t(total) * i / n))
+					{
+						index_t bound = (id + 1) << config::BitsPerLayer;
+						if (bound > bounds.back() && bound < end)
+							bounds.push_back(bound);
+						while (i < n && acc >= index_t(uint64_t(total) * i / n))
+							++i;
+					}
+				});
+			}
+			bounds.push_back(end);
+			return bounds;
+		}
+
+		//组合位数组(and/or/not 是 C++ 的替代记号,因此名字带下划线)
 		template<typename... Ts>
-		__forceinline chbv<and_op_t, std::decay_t<Ts>...> and(Ts&&... args)
+		__forceinline chbv<and_op_t, std::decay_t<Ts>...> and_(Ts&&... args)
 		{
 			return { std::forward<Ts>(args)... };
 		}
 
 		template<typename... Ts>
-		__forceinline chbv<or_op_t, std::decay_t<Ts>...> or(Ts&&... args)
+		__forceinline chbv<or_op_t, std::decay_t<Ts>...> or_(Ts&&... args)
 		{
 			return { std::forward<Ts>(args)... };
 		}
@@ -823,11 +1861,19 @@ namespace common
 		//注意因为分层位数组的算法原理并不支持非操作
 		//此方法会使得分层位数组退化为普通位数组(慢!
 		template<typename T>
-		__forceinline chbv_not<std::decay_t<T>> not(T&& arg)
+		__forceinline chbv_not<std::decay_t<T>> not_(T&& arg)
 		{
 			return { std::forward<T>(arg) };
 		}
 
+		//与非位数组(arg & ~exclude),保持arg的分层结构
+		//排除查询应该优先使用此方法而不是and_(arg, not_(exclude))
+		template<typename T, typename U>
+		__forceinline chbv_andnot<std::decay_t<T>, std::decay_t<U>> andnot(T&& arg, U&& exclude)
+		{
+			return { std::forward<T>(arg), std::forward<U>(exclude) };
+		}
+
 		//判断位数组(或组合位数组)是否为空
 		template<typename T>
 		__forceinline bool empty(const T& vec)
@@ -837,12 +1883,27 @@ namespace common
 	}
 
 	using hbv_detail::index_t;
+	using hbv_detail::hbv_config;
+	using hbv_detail::basic_hbv;
 	using hbv_detail::hbv;
-	using hbv_detail::and;
-	using hbv_detail::or ;
-	using hbv_detail::not;
+	using hbv_detail::small_hbv;
+	using hbv_detail::large_hbv;
+	using hbv_detail::counted_hbv;
+	using hbv_detail::basic_atomic_hbv;
+	using hbv_detail::atomic_hbv;
+	using hbv_detail::block_pool;
+	using hbv_detail::shared_block_pool;
+	using hbv_detail::and_;
+	using hbv_detail::or_;
+	using hbv_detail::not_;
+	using hbv_detail::andnot;
 	using hbv_detail::empty;
 	using hbv_detail::last;
 	using hbv_detail::first;
 	using hbv_detail::for_each;
+	using hbv_detail::count;
+	using hbv_detail::estimate;
+	using hbv_detail::for_each_run;
+	using hbv_detail::for_each_word;
+	using hbv_detail::split;
 }
@@ -0,0 +1,297 @@
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace common
+{
+	namespace pool_detail
+	{
+		using index_t = uint32_t;
+
+		//一次 parallel_for 调用,任务之间共享
+		struct job
+		{
+			void(*run)(const void* body, index_t begin, index_t end);
+			const void* body;
+			//可选,判断区间内是否没有需要执行的内容,为真的区间在切分时直接丢弃
+			bool(*empty)(const void* body, index_t begin, index_t end);
+			const void* probe;
+			index_t grain;
+			//尚未执行完的区间长度,为 0 时调用返回
+			std::atomic<index_t> remaining;
+		};
+
+		//一个待执行的区间 [begin, end)
+		struct task
+		{
+			job* owner;
+			index_t begin;
+			index_t end;
+		};
+
+		//每个线程一个队列,自己从尾部存取,其他线程从头部窃取(大的区间先被窃取)
+		struct alignas(64) work_queue
+		{
+			std::mutex lock;
+			std::deque<task> tasks;
+
+			void push(const task& t)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				tasks.push_back(t);
+			}
+
+			bool pop(task& t)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (tasks.empty())
+					return false;
+				t = tasks.back();
+				tasks.pop_back();
+				return true;
+			}
+
+			bool steal(task& t)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (tasks.empty())
+					return false;
+				t = tasks.front();
+				tasks.pop_front();
+				return true;
+			}
+		};
+
+		/*
+		工作窃取线程池
+		parallel_for 把区间按 grain 惰性二分:执行前把右半部分放入自己的队列,继续处理左半部分,直到不大于 grain
+		空闲的线程从其他队列的头部窃取区间,调用线程也参与执行,直到整个区间完成才返回
+		工作线程内可以嵌套调用 parallel_for,外部线程的调用之间互斥
+		*/
+		class job_pool
+		{
+			std::vector<std::thread> _workers;
+			//最后一个队列属于外部调用线程
+			std::unique_ptr<work_queue[]> _queues;
+			index_t _queueCount;
+			std::mutex _external;
+
+			//队列中的任务数量和正在睡眠的工作线程数量,用于唤醒
+			std::atomic<index_t> _queued{ 0u };
+			std::atomic<index_t> _sleeping{ 0u };
+			std::mutex _sleep;
+			std::condition_variable _wake;
+			bool _stop = false;
+
+			struct thread_slot
+			{
+				const job_pool* pool;
+				index_t slot;
+			};
+
+			static thread_slot& current() noexcept
+			{
+				static thread_local thread_slot slot{ nullptr, 0u };
+				return slot;
+			}
+
+			void push(index_t slot, const task& t)
+			{
+				_queues[slot].push(t);
+				_queued.fetch_add(1u);
+				if (_sleeping.load() > 0u)
+				{
+					{ std::lock_guard<std::mutex> guard(_sleep); }
+					_wake.notify_one();
+				}
+			}
+
+			//先取自己的队列,再从其他队列窃取
+			bool acquire(index_t slot, std::minstd_rand& rng, task& t)
+			{
+				if (_queues[slot].pop(t))
+				{
+					_queued.fetch_sub(1u);
+					return true;
+				}
+				index_t start = index_t(rng() % _queueCount);
+				for (index_t i = 0; i < _queueCount; ++i)
+				{
+					index_t victim = (start + i) % _queueCount;
+					if (victim != slot && _queues[victim].steal(t))
+					{
+						_queued.fetch_sub(1u);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			void execute(index_t slot, task t)
+			{
+				job& j = *t.owner;
+				index_t skipped = 0u;
+				while (t.end - t.begin > j.grain)
+				{
+					//切分点对齐到 grain,使每段对应完整的 hbv 子树
+					index_t mid = t.begin + (t.end - t.begin) / 2u;
+					mid -= mid % j.grain;
+					if (mid <= t.begin)
+						mid = t.begin + j.grain;
+					//空的一半不放入队列,只计入完成的长度
+					if (j.empty && j.empty(j.probe, mid, t.end))
+						skipped += t.end - mid;
+					else if (j.empty && j.empty(j.probe, t.begin, mid))
+					{
+						skipped += mid - t.begin;
+						t.begin = mid;
+						continue;
+					}
+					else
+						push(slot, { t.owner, mid, t.end });
+					t.end = mid;
+				}
+				if (!j.empty || !j.empty(j.probe, t.begin, t.end))
+					j.run(j.body, t.begin, t.end);
+				j.remaining.fetch_sub(t.end - t.begin + skipped, std::memory_order_acq_rel);
+			}
+
+			void work(index_t slot)
+			{
+				current() = { this, slot };
+				std::minstd_rand rng(slot + 1u);
+				task t;
+				for (;;)
+				{
+					if (acquire(slot, rng, t))
+					{
+						execute(slot, t);
+						continue;
+					}
+					std::unique_lock<std::mutex> guard(_sleep);
+					if (_stop)
+						return;
+					_sleeping.fetch_add(1u);
+					if (_queued.load() == 0u)
+						_wake.wait(guard);
+					_sleeping.fetch_sub(1u);
+				}
+			}
+
+			template<typename F>
+			static void invoke(const void* body, index_t begin, index_t end)
+			{
+				(*static_cast<const F*>(body))(begin, end);
+			}
+
+			template<typename E>
+			static bool probe(const void* body, index_t begin, index_t end)
+			{
+				return (*static_cast<const E*>(body))(begin, end);
+			}
+
+		public:
+			//threads 为工作线程数量,调用线程额外参与执行
+			explicit job_pool(index_t threads = std::max(1u, std::thread::hardware_concurrency()) - 1u)
+				: _queues(new work_queue[threads + 1u]), _queueCount(threads + 1u)
+			{
+				_workers.reserve(threads);
+				for (index_t i = 0; i < threads; ++i)
+					_workers.emplace_back([this, i] { work(i); });
+			}
+
+			~job_pool()
+			{
+				{
+					std::lock_guard<std::mutex> guard(_sleep);
+					_stop = true;
+				}
+				_wake.notify_all();
+				for (auto& worker : _workers)
+					worker.join();
+			}
+
+			job_pool(const job_pool&) = delete;
+			job_pool& operator=(const job_pool&) = delete;
+
+			static job_pool& instance()
+			{
+				static job_pool pool;
+				return pool;
+			}
+
+			//参与执行的线程数量(包括调用线程)
+			index_t concurrency() const noexcept
+			{
+				return _queueCount;
+			}
+
+			//并行执行 f(begin, end),区间按 grain 切分(不需要并行时整体调用一次),返回时全部执行完毕
+			template<typename F>
+			void parallel_for(index_t begin, index_t end, index_t grain, const F& f)
+			{
+				dispatch(begin, end, grain, f, nullptr, nullptr);
+			}
+
+			//同上,empty(begin, end) 为真的子区间在切分时跳过,不会作为任务放入队列
+			template<typename F, typename E>
+			void parallel_for(index_t begin, index_t end, index_t grain, const F& f, const E& empty)
+			{
+				dispatch(begin, end, grain, f, &probe<E>, &empty);
+			}
+
+		private:
+			template<typename F>
+			void dispatch(index_t begin, index_t end, index_t grain, const F& f, bool(*empty)(const void*, index_t, index_t), const void* probe)
+			{
+				if (begin >= end)
+					return;
+				grain = std::max(grain, 1u);
+				if (end - begin <= grain || _workers.empty())
+				{
+					f(begin, end);
+					return;
+				}
+				thread_slot& self = current();
+				if (self.pool != this)
+				{
+					//外部线程占用最后一个队列,调用期间登记为本线程池的线程(以支持嵌套调用)
+					std::lock_guard<std::mutex> external(_external);
+					thread_slot saved = self;
+					self = { this, _queueCount - 1u };
+					run(self.slot, begin, end, grain, f, empty, probe);
+					self = saved;
+				}
+				else
+					run(self.slot, begin, end, grain, f, empty, probe);
+			}
+
+			template<typename F>
+			void run(index_t slot, index_t begin, index_t end, index_t grain, const F& f, bool(*empty)(const void*, index_t, index_t), const void* probe)
+			{
+				job j{ &invoke<F>, &f, empty, probe, grain, { end - begin } };
+				std::minstd_rand rng(slot + 1u);
+				execute(slot, { &j, begin, end });
+				//等待被窃取的部分,期间帮助执行其他任务
+				task t;
+				while (j.remaining.load(std::memory_order_acquire) != 0u)
+				{
+					if (acquire(slot, rng, t))
+						execute(slot, t);
+					else
+						std::this_thread::yield();
+				}
+			}
+		};
+	}
+
+	using pool_detail::job_pool;
+}
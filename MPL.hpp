@@ -4,6 +4,7 @@
 #include <variant>
 #include <tuple>
 #include <vector>
+#include <memory>
 
 namespace common
 {
@@ -93,7 +94,7 @@ namespace common
 	template<template<typename T> class F, typename... Ts>
 	constexpr auto filter(typelist<Ts...>)
 	{
-		static const auto f = folder{
+		const auto f = folder{
 			typelist<>{}, //first
 			[](auto a, auto c) //next
 			{
@@ -246,7 +247,7 @@ namespace common
 	template <typename T, typename F>
 	constexpr decltype(auto) for_types(F &&f)
 	{
-		if constexpr (size<T>{} > 0u)
+		if constexpr (size<T> > 0u)
 			return for_tuple(rewrap_t<std::tuple, map_t<type_t, T>>{}, f);
 	}
 
@@ -0,0 +1,158 @@
+﻿#pragma once
+#include "View.hpp"
+#include "JobPool.hpp"
+#include <array>
+#include <utility>
+
+namespace ecs
+{
+	namespace schedule_detail
+	{
+		//system 的访问权限,由 view 的类型得到:const 为读,否则为写
+		template<typename V>
+		struct access;
+
+		template<typename... Ts>
+		struct access<std::tuple<Ts&...>>
+		{
+			using type = common::typelist<Ts...>;
+		};
+
+		template<typename S>
+		using access_t = typename access<decltype(std::declval<S&>().view)>::type;
+
+		//A 写入的资源被 B 访问(读或写)
+		template<typename A, typename B>
+		struct write_conflict;
+
+		template<typename... As, typename B>
+		struct write_conflict<common::typelist<As...>, B>
+			: std::disjunction<std::bool_constant<!std::is_const_v<As> && (common::contain_v<As, B> || common::contain_v<const As, B>)>...> {};
+
+		//读和读不冲突,其余情况冲突
+		template<typename A, typename B>
+		struct conflict : std::disjunction<write_conflict<A, B>, write_conflict<B, A>> {};
+
+		/*
+		按注册顺序执行一组 system,互不冲突的 system 在线程池上并行执行
+		冲突图在编译期由各个 system 的 view 推导,每个 system 被分配到比所有与之冲突的先注册 system 更晚的阶段
+		同一阶段内的 system 两两不冲突,阶段之间顺序执行,因此冲突的 system 之间总是保持注册顺序
+		system 需要有 view 成员(如 View(...) 或 JobSystem 定义的)和 Update(),view 之外的共享状态需要自己保证安全
+		*/
+		template<typename... Ss>
+		class schedule
+		{
+			static constexpr std::size_t Count = sizeof...(Ss);
+			using accesses = std::tuple<access_t<Ss>...>;
+
+			template<std::size_t I>
+			static constexpr bool conflict_at() noexcept
+			{
+				constexpr std::size_t i = I / Count, j = I % Count;
+				if constexpr (i == j)
+					return false;
+				else
+					return conflict<std::tuple_element_t<i, accesses>, std::tuple_element_t<j, accesses>>::value;
+			}
+
+			template<std::size_t... Is>
+			static constexpr std::array<bool, Count * Count> make_graph(std::index_sequence<Is...>) noexcept
+			{
+				return { { conflict_at<Is>()... } };
+			}
+
+			//邻接矩阵,graph[i * Count + j] 表示 i 和 j 冲突
+			static constexpr std::array<bool, Count * Count> graph = make_graph(std::make_index_sequence<Count * Count>{});
+
+			static constexpr std::array<std::size_t, Count> make_stages() noexcept
+			{
+				std::array<std::size_t, Count> stage{};
+				for (std::size_t j = 0; j < Count; ++j)
+					for (std::size_t i = 0; i < j; ++i)
+						if (graph[i * Count + j] && stage[j] <= stage[i])
+							stage[j] = stage[i] + 1;
+				return stage;
+			}
+
+			static constexpr std::array<std::size_t, Count> stage = make_stages();
+
+			static constexpr std::size_t make_stage_count() noexcept
+			{
+				std::size_t count = 0;
+				for (std::size_t i = 0; i < Count; ++i)
+					count = std::max(count, stage[i] + 1);
+				return count;
+			}
+
+			//按阶段排列的 system 下标,阶段内保持注册顺序
+			static constexpr std::array<std::size_t, Count> make_order() noexcept
+			{
+				std::array<std::size_t, Count> order{};
+				std::size_t n = 0;
+				for (std::size_t s = 0; s < make_stage_count(); ++s)
+					for (std::size_t i = 0; i < Count; ++i)
+						if (stage[i] == s)
+							order[n++] = i;
+				return order;
+			}
+
+			static constexpr std::array<std::size_t, Count> order = make_order();
+
+			using systems = std::tuple<Ss&...>;
+			systems _systems;
+
+			template<std::size_t I>
+			static void update(systems& ss)
+			{
+				std::get<I>(ss).Update();
+			}
+
+			template<std::size_t... Is>
+			static constexpr std::array<void(*)(systems&), Count> make_updates(std::index_sequence<Is...>) noexcept
+			{
+				return { { &update<Is>... } };
+			}
+
+		public:
+			static constexpr std::size_t StageCount = make_stage_count();
+
+			explicit schedule(Ss&... ss) noexcept : _systems(ss...) {}
+
+			//第 i 个和第 j 个 system 是否冲突
+			static constexpr bool conflicts(std::size_t i, std::size_t j) noexcept
+			{
+				return graph[i * Count + j];
+			}
+
+			//第 i 个 system 所在的阶段
+			static constexpr std::size_t stage_of(std::size_t i) noexcept
+			{
+				return stage[i];
+			}
+
+			//执行一帧,返回时所有 system 都已执行完毕
+			void run()
+			{
+				static constexpr auto updates = make_updates(std::index_sequence_for<Ss...>{});
+				std::size_t begin = 0;
+				while (begin < Count)
+				{
+					std::size_t end = begin;
+					while (end < Count && stage[order[end]] == stage[order[begin]])
+						++end;
+					common::job_pool::instance().parallel_for(index_t(begin), index_t(end), 1u, [this](index_t b, index_t e)
+					{
+						for (index_t k = b; k < e; ++k)
+							updates[order[k]](_systems);
+					});
+					begin = end;
+				}
+			}
+		};
+
+		template<typename... Ss>
+		schedule(Ss&...)->schedule<Ss...>;
+	}
+
+	using schedule_detail::schedule;
+}
@@ -1,4 +1,5 @@
 #pragma once
 #include "Storages/NullStorage.hpp"
 #include "Storages/DenseVector.hpp"
-#include "Storages/UniqueVector.hpp"
\ No newline at end of file
+#include "Storages/UniqueVector.hpp"
+#include "Storages/SoaVector.hpp"
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ecs
+{
+	/*
+	storage ķ׼ Allocator ĸ,storage ڲҪ rebind
+	 std::allocator ,ṩж롢ҳ pmr ڴ( world::arena)ֺ
+	*/
+
+	// Align ֽ(ĬΪ)ķ
+	template<typename T, std::size_t Align = 64u>
+	class aligned_allocator
+	{
+		static constexpr std::size_t Alignment = std::max(Align, alignof(T));
+	public:
+		using value_type = T;
+		template<typename U>
+		struct rebind { using other = aligned_allocator<U, Align>; };
+
+		aligned_allocator() noexcept = default;
+		template<typename U>
+		aligned_allocator(const aligned_allocator<U, Align>&) noexcept {}
+
+		T* allocate(std::size_t n)
+		{
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+		}
+
+		void deallocate(T* p, std::size_t) noexcept
+		{
+			::operator delete(p, std::align_val_t(Alignment));
+		}
+
+		template<typename U>
+		bool operator==(const aligned_allocator<U, Align>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const aligned_allocator<U, Align>&) const noexcept { return false; }
+	};
+
+	/*
+	ҳ,Сһҳ(2MB)ķ䰴ҳ, linux Ͻںʹ͸ҳ
+	Сķ䰴ж,ʺϽϴ BucketBits ʹԼ TLB ȱʧ
+	*/
+	template<typename T>
+	class huge_page_allocator
+	{
+		static constexpr std::size_t LineSize = std::max<std::size_t>(64u, alignof(T));
+
+		static std::size_t alignment_of(std::size_t bytes) noexcept
+		{
+			return bytes >= HugePageSize ? HugePageSize : LineSize;
+		}
+
+		static std::size_t rounded(std::size_t bytes) noexcept
+		{
+			return bytes >= HugePageSize ? (bytes + HugePageSize - 1u) / HugePageSize * HugePageSize : bytes;
+		}
+
+	public:
+		using value_type = T;
+		static constexpr std::size_t HugePageSize = std::size_t(2u) << 20;
+
+		huge_page_allocator() noexcept = default;
+		template<typename U>
+		huge_page_allocator(const huge_page_allocator<U>&) noexcept {}
+
+		T* allocate(std::size_t n)
+		{
+			std::size_t bytes = rounded(n * sizeof(T));
+			void* p = ::operator new(bytes, std::align_val_t(alignment_of(bytes)));
+#ifdef __linux__
+			if (bytes >= HugePageSize)
+				madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+			return static_cast<T*>(p);
+		}
+
+		void deallocate(T* p, std::size_t n) noexcept
+		{
+			::operator delete(p, std::align_val_t(alignment_of(rounded(n * sizeof(T)))));
+		}
+
+		template<typename U>
+		bool operator==(const huge_page_allocator<U>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const huge_page_allocator<U>&) const noexcept { return false; }
+	};
+
+	/*
+	ڴ,ͷʱʲôҲ,ڴʱ黹,ʺ϶ world
+	,world ̳߳ϲд components ʱҲ԰ȫʹ
+	*/
+	class arena_resource final : public std::pmr::memory_resource
+	{
+		std::mutex _lock;
+		std::pmr::monotonic_buffer_resource _arena;
+
+	public:
+		explicit arena_resource(std::size_t initial = 1u << 16) : _arena(initial) {}
+
+		//黹ڴ,ֻû storage ʹʱ
+		void release()
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			_arena.release();
+		}
+
+	private:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			std::lock_guard<std::mutex> guard(_lock);
+			return _arena.allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	// memory_resource( world::arena)ķ
+	template<typename T>
+	using arena_allocator = std::pmr::polymorphic_allocator<T>;
+}
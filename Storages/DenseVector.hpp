@@ -6,20 +6,25 @@ namespace ecs
 	/*
 	dense_vector һܵݲһضλ
 	ڽϴԱ˷ڴ
+	ɾһԪλ,ɾʣԪص˳
+	 owner (sort_by_owner) hbv ˳ΪԷ,ɾ±źȻ
+	ضͨ Allocator 
 	*/
-	template<typename T>
-	class dense_vector
+	template<typename T, typename Allocator = std::allocator<T>>
+	class basic_dense_vector
 	{
 		struct elem 
 		{ 
 			T data; index_t owner; 
 			elem(const T& d, index_t o) : data(d), owner(o) {}
 		};
-		std::vector<elem> _components;
-		sparse_vector<index_t> _redirector;
+		template<typename U>
+		using allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
+		std::vector<elem, allocator_t<elem>> _components;
+		basic_sparse_vector<index_t, allocator_t<index_t>> _redirector;
 	public:
-		dense_vector(const common::hbv& entities)
-			: _redirector(entities)
+		basic_dense_vector(const entity_hbv& entities, const Allocator& allocator = Allocator())
+			: _components(allocator_t<elem>(allocator)), _redirector(entities, allocator_t<index_t>(allocator))
 		{
 		}
 
@@ -40,6 +45,14 @@ namespace ecs
 			return _components.back().data;
 		}
 
+		//鱾Ҫƶ,ֻҪ±ض owner
+		void remap(const entity_hbv& old, const id_remap& table)
+		{
+			_redirector.remap(old, table);
+			for (auto& c : _components)
+				c.owner = table[c.owner];
+		}
+
 		void remove(index_t e)
 		{
 			if (_components.size() > 1)
@@ -52,11 +65,70 @@ namespace ecs
 			_components.pop_back();
 			_redirector.remove(e);
 		}
+
+		//αѹ,ӵһɾλÿʼѱԪǰ
+		void batch_remove(const and_chbv& remove)
+		{
+			const auto& redirector = _redirector;
+			index_t first = index_t(_components.size());
+			common::for_each(remove, [&redirector, &first](index_t e)
+			{
+				first = std::min(first, redirector.get(e));
+			});
+			index_t kept = first;
+			for (index_t i = first; i < _components.size(); ++i)
+			{
+				index_t owner = _components[i].owner;
+				if (remove.contain(owner))
+					continue;
+				if (kept != i)
+				{
+					_components[kept] = std::move(_components[i]);
+					_redirector.get(owner) = kept;
+				}
+				++kept;
+			}
+			_components.erase(_components.begin() + kept, _components.end());
+		}
+
+		// owner 
+		void sort_by_owner()
+		{
+			std::sort(_components.begin(), _components.end(), [](const elem& a, const elem& b) { return a.owner < b.owner; });
+			for (index_t i = 0; i < _components.size(); ++i)
+				_redirector.get(_components[i].owner) = i;
+		}
+
+		//ͷضбΪյͰ
+		void after_batch_remove()
+		{
+			_redirector.after_batch_remove();
+		}
+	};
+
+	//Ĭõ dense_vector
+	template<typename T>
+	class dense_vector : public basic_dense_vector<T>
+	{
+	public:
+		using basic_dense_vector<T>::basic_dense_vector;
+	};
+
+	//ָ dense_vector,sort_by_owner ͨ container 
+	template<typename Allocator>
+	struct dense_storage
+	{
+		template<typename T>
+		using type = basic_dense_vector<T, Allocator>;
 	};
 
 	DefStorage(dense_vector)
 	{
 	public:
 		DefConstructor(dense_vector) : generic(_has) {}
+		void sort_by_owner() noexcept
+		{
+			container.sort_by_owner();
+		}
 	};
 }
\ No newline at end of file
@@ -40,6 +40,10 @@ namespace ecs
 		void remove(index_t e)
 		{
 		}
+
+		void remap(const entity_hbv& old, const id_remap& table)
+		{
+		}
 	};
 
 	DefStorage(null_storage)
@@ -49,13 +53,13 @@ namespace ecs
 
 		auto &get(index_t e) noexcept
 		{
-			static_assert(false, "don't get from placeholder");
+			static_assert(sizeof(T) == 0, "don't get from placeholder");
 			return generic::get(e);
 		}
 
 		const auto &get(index_t e) const noexcept
 		{
-			static_assert(false, "don't get from placeholder");
+			static_assert(sizeof(T) == 0, "don't get from placeholder");
 			return generic::get(e);
 		}
 	};
@@ -0,0 +1,351 @@
+#pragma once
+#include "../Components.hpp"
+#include "../Traits.hpp"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+
+namespace ecs
+{
+	namespace soa_detail
+	{
+		template<typename M>
+		struct member_of;
+
+		template<typename F, typename T>
+		struct member_of<F T::*>
+		{
+			using type = F;
+		};
+
+		// soa_layout õÿֶεͺͰеƫ,ͰĴСΪ 2^BucketBits Ԫ
+		template<typename T, index_t BucketBits>
+		struct layout
+		{
+			static constexpr auto Fields = soa_layout<T>::fields;
+			static constexpr std::size_t FieldCount = std::tuple_size_v<std::decay_t<decltype(Fields)>>;
+			static_assert(FieldCount > 0u, "soa layout needs at least one field");
+			//ÿֶε鰴ж
+			static constexpr std::size_t Align = 64u;
+
+			static constexpr index_t BucketSize = 1 << BucketBits;
+
+			template<std::size_t I>
+			using field_t = typename member_of<std::decay_t<std::tuple_element_t<I, std::decay_t<decltype(Fields)>>>>::type;
+
+			template<std::size_t... Is>
+			static constexpr std::array<std::size_t, FieldCount + 1u> make_offsets(std::index_sequence<Is...>) noexcept
+			{
+				static_assert(((alignof(field_t<Is>) <= Align) && ...), "field is over aligned");
+				std::array<std::size_t, FieldCount + 1u> offsets{};
+				const std::size_t sizes[] = { sizeof(field_t<Is>)... };
+				for (std::size_t i = 0; i < FieldCount; ++i)
+					offsets[i + 1u] = (offsets[i] + sizes[i] * BucketSize + Align - 1u) / Align * Align;
+				return offsets;
+			}
+
+			//offsets[i] Ϊ i ֶεͰеƫ,һΪͰĴС
+			static constexpr auto Offsets = make_offsets(std::make_index_sequence<FieldCount>());
+
+			template<std::size_t I, typename B>
+			static auto field(B* base) noexcept
+			{
+				using F = std::conditional_t<std::is_const_v<B>, const field_t<I>, field_t<I>>;
+				return reinterpret_cast<F*>(base + Offsets[I]);
+			}
+
+			//ԱָӦֶ
+			template<auto M, std::size_t I = 0u>
+			static constexpr std::size_t index_of() noexcept
+			{
+				static_assert(I < FieldCount, "member is not in the soa layout");
+				if constexpr (std::is_same_v<decltype(M), std::decay_t<decltype(std::get<I>(Fields))>>)
+				{
+					if constexpr (std::get<I>(Fields) == M)
+						return I;
+					else
+						return index_of<M, I + 1u>();
+				}
+				else
+					return index_of<M, I + 1u>();
+			}
+		};
+
+		/*
+		soa_vector һԪصĴ,U Ϊ const T ʱֻ
+		get<I>()  field<&T::x>() ʵֶ,Ϊ T д
+		*/
+		template<typename U, index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+		class soa_ref
+		{
+			using T = std::remove_const_t<U>;
+			using layout_t = layout<T, BucketBits>;
+			using byte_t = std::conditional_t<std::is_const_v<U>, const std::byte, std::byte>;
+			byte_t* _base;
+			index_t _index;
+
+			template<std::size_t... Is>
+			void gather(T& value, std::index_sequence<Is...>) const
+			{
+				((value.*std::get<Is>(layout_t::Fields) = get<Is>()), ...);
+			}
+
+			template<std::size_t... Is>
+			void scatter(const T& value, std::index_sequence<Is...>) const
+			{
+				((get<Is>() = value.*std::get<Is>(layout_t::Fields)), ...);
+			}
+
+		public:
+			soa_ref(byte_t* base, index_t index) noexcept : _base(base), _index(index) {}
+
+			template<std::size_t I>
+			auto& get() const noexcept
+			{
+				return layout_t::template field<I>(_base)[_index];
+			}
+
+			template<auto M>
+			auto& field() const noexcept
+			{
+				return get<layout_t::template index_of<M>()>();
+			}
+
+			operator T() const
+			{
+				static_assert(std::is_default_constructible_v<T>, "soa component should be default constructible to be read as a whole");
+				T value{};
+				gather(value, std::make_index_sequence<layout_t::FieldCount>());
+				return value;
+			}
+
+			const soa_ref& operator=(const T& value) const
+			{
+				static_assert(!std::is_const_v<U>, "can't write through a const soa reference");
+				scatter(value, std::make_index_sequence<layout_t::FieldCount>());
+				return *this;
+			}
+		};
+
+		/*
+		soa_vector дĳԪؿʼͰĩβ,Ϊ chunk ָ
+		get<I>()/field<&T::x>() õֶε,chunk 뵽ײڵ,ֶ鰴 64 Ԫض
+		*/
+		template<typename U, index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+		class soa_pointer
+		{
+			using T = std::remove_const_t<U>;
+			using layout_t = layout<T, BucketBits>;
+			using byte_t = std::conditional_t<std::is_const_v<U>, const std::byte, std::byte>;
+			byte_t* _base;
+			index_t _index;
+
+		public:
+			soa_pointer(byte_t* base, index_t index) noexcept : _base(base), _index(index) {}
+
+			template<std::size_t I>
+			auto get() const noexcept
+			{
+				return layout_t::template field<I>(_base) + _index;
+			}
+
+			template<auto M>
+			auto field() const noexcept
+			{
+				return get<layout_t::template index_of<M>()>();
+			}
+
+			soa_ref<U, BucketBits> operator[](index_t i) const noexcept
+			{
+				return { _base, _index + i };
+			}
+		};
+	}
+
+	using soa_detail::soa_ref;
+	using soa_detail::soa_pointer;
+
+	/*
+	soa_vector  soa_layout  component Ϊÿֶһ(structure of arrays),ֻȡֶε job ض component
+	ͰĻ sparse_vector ͬ( entity id,һͰӦ hbv һڵ,ĬΪڶ),Ͱÿֶε鰴ж
+	Ͱͨ Allocator з
+	get ش soa_ref,chunks  chunk<T>  data Ϊ soa_pointer,԰ֶȡ SIMD 
+	ʱ job  const T& ȡ(),дҪͨ chunk
+	*/
+	template<typename T, typename Allocator = std::allocator<T>, index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+	class basic_soa_vector
+	{
+		using layout_t = soa_detail::layout<T, BucketBits>;
+		using config = entity_hbv::config;
+		static_assert(BucketBits % config::BitsPerLayer == 0u && BucketBits >= config::BitsPerLayer && BucketBits < config::LayerCount * config::BitsPerLayer,
+			"bucket of soa vector should be a node of hbv");
+		static constexpr index_t BucketLevel = config::LayerCount - BucketBits / config::BitsPerLayer;
+		static constexpr index_t BucketSize = layout_t::BucketSize;
+		static constexpr std::size_t FieldCount = layout_t::FieldCount;
+		static constexpr std::size_t LineCount = layout_t::Offsets[FieldCount] / layout_t::Align;
+		index_t bucket_of(index_t i) const { return i >> BucketBits; }
+		index_t index_of(index_t i) const { return i & (BucketSize - 1); }
+
+		//ͰΪλ
+		struct alignas(layout_t::Align) line { std::byte bytes[layout_t::Align]; };
+		using allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<line>;
+
+		const entity_hbv& _entities;
+		std::vector<std::byte*> _buckets;
+		allocator_t _allocator;
+
+		std::byte* allocate_bucket()
+		{
+			return reinterpret_cast<std::byte*>(std::allocator_traits<allocator_t>::allocate(_allocator, LineCount));
+		}
+
+		void free_bucket(std::byte* bucket) noexcept
+		{
+			if (bucket != nullptr)
+				std::allocator_traits<allocator_t>::deallocate(_allocator, reinterpret_cast<line*>(bucket), LineCount);
+		}
+
+		template<std::size_t... Is>
+		void construct(std::byte* bucket, index_t i, const T& arg, std::index_sequence<Is...>)
+		{
+			(new (layout_t::template field<Is>(bucket) + i) typename layout_t::template field_t<Is>(arg.*std::get<Is>(layout_t::Fields)), ...);
+		}
+
+		template<std::size_t... Is>
+		static void destruct(std::byte* bucket, index_t i, std::index_sequence<Is...>) noexcept
+		{
+			(std::destroy_at(layout_t::template field<Is>(bucket) + i), ...);
+		}
+
+		template<std::size_t... Is>
+		static void relocate(std::byte* to, index_t j, std::byte* from, index_t i, std::index_sequence<Is...>)
+		{
+			(new (layout_t::template field<Is>(to) + j) typename layout_t::template field_t<Is>(std::move(layout_t::template field<Is>(from)[i])), ...);
+			destruct(from, i, std::index_sequence<Is...>());
+		}
+
+	public:
+		//Ͱÿֶ
+		static constexpr index_t ChunkSize = BucketSize;
+		template<typename U>
+		using pointer = soa_pointer<U, BucketBits>;
+
+		basic_soa_vector(const entity_hbv& entities, const Allocator& allocator = Allocator())
+			: _entities(entities), _buckets(10u, nullptr), _allocator(allocator) {}
+
+		//Ԫ components ,ֻͷͰ
+		~basic_soa_vector()
+		{
+			for (std::byte* bucket : _buckets)
+				free_bucket(bucket);
+		}
+
+		basic_soa_vector(const basic_soa_vector&) = delete;
+		basic_soa_vector& operator=(const basic_soa_vector&) = delete;
+
+		soa_ref<T, BucketBits> get(index_t e)
+		{
+			return { _buckets[bucket_of(e)], index_of(e) };
+		}
+
+		soa_ref<const T, BucketBits> get(index_t e) const
+		{
+			return { _buckets[bucket_of(e)], index_of(e) };
+		}
+
+		// e ʼͰĩβԪصÿֶ
+		soa_pointer<T, BucketBits> data(index_t e)
+		{
+			return { _buckets[bucket_of(e)], index_of(e) };
+		}
+
+		soa_pointer<const T, BucketBits> data(index_t e) const
+		{
+			return { _buckets[bucket_of(e)], index_of(e) };
+		}
+
+		soa_ref<T, BucketBits> create(index_t e, const T& arg)
+		{
+			index_t bucket = bucket_of(e);
+			if (_buckets.size() <= bucket)
+				_buckets.resize(bucket + _buckets.size(), nullptr);
+			if (_buckets[bucket] == nullptr)
+				_buckets[bucket] = allocate_bucket();
+			construct(_buckets[bucket], index_of(e), arg, std::make_index_sequence<FieldCount>());
+			return get(e);
+		}
+
+		void remove(index_t e)
+		{
+			index_t bucket = bucket_of(e);
+			destruct(_buckets[bucket], index_of(e), std::make_index_sequence<FieldCount>());
+			if (!_entities.layer(BucketLevel, bucket) && _buckets[bucket])
+			{
+				free_bucket(_buckets[bucket]);
+				_buckets[bucket] = nullptr;
+			}
+		}
+
+		void batch_remove(const and_chbv& remove)
+		{
+			common::for_each(remove, [this](index_t i)
+			{
+				destruct(_buckets[bucket_of(i)], index_of(i), std::make_index_sequence<FieldCount>());
+			});
+		}
+
+		//ű old еԪֶΰƵµͰ
+		void remap(const entity_hbv& old, const id_remap& table)
+		{
+			std::vector<std::byte*> fresh(std::max<std::size_t>(_buckets.size(), 10u), nullptr);
+			common::for_each(old, [this, &fresh, &table](index_t i)
+			{
+				index_t n = table[i];
+				index_t bucket = bucket_of(n);
+				if (fresh[bucket] == nullptr)
+					fresh[bucket] = allocate_bucket();
+				relocate(fresh[bucket], index_of(n), _buckets[bucket_of(i)], index_of(i), std::make_index_sequence<FieldCount>());
+			});
+			for (std::byte* bucket : _buckets)
+				free_bucket(bucket);
+			_buckets.swap(fresh);
+		}
+
+		//ͷűΪյͰ
+		void after_batch_remove()
+		{
+			for (index_t i = 0; i < _buckets.size(); ++i)
+			{
+				if (_buckets[i] && !_entities.layer(BucketLevel, i))
+				{
+					free_bucket(_buckets[i]);
+					_buckets[i] = nullptr;
+				}
+			}
+		}
+	};
+
+	//Ĭõ soa_vector
+	template<typename T>
+	class soa_vector : public basic_soa_vector<T>
+	{
+	public:
+		using basic_soa_vector<T>::basic_soa_vector;
+	};
+
+	//ָͰС soa_vector
+	template<typename Allocator, index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+	struct soa_storage
+	{
+		template<typename T>
+		using type = basic_soa_vector<T, Allocator, BucketBits>;
+	};
+
+	DefStorage(soa_vector)
+	{
+	public:
+		DefConstructor(soa_vector) : generic(_has) {}
+	};
+}
@@ -1,28 +1,182 @@
 #pragma once
 #include "../Components.hpp"
+#include "Allocators.hpp"
+#include <atomic>
 namespace ecs
 {
 	/*
 	sparse_vector Ϊܶ,һȫΪʱͷŵڴ
 	ɢֲҽСԵõϺõ
+	ÿͰͰÿ 64 Ԫ(hbv ײһڵ)¼һдʱİ汾,д get/data  create °汾
+	changed_since õ汾ڸֵĲ,Ͱ/ڵûбд
+	Ͱͨ Allocator ,ͰĴСΪ 2^BucketBits Ԫ(Ҫ뵽 hbv һ,ĬΪ 4096),ϴ component ýСͰ
 	*/
-	template<typename T>
-	class sparse_vector
+	template<typename T, typename Allocator = std::allocator<T>, common::index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+	class basic_sparse_vector
 	{
 		using index_t = common::index_t;
-		const common::hbv& _entities;
-		std::vector<T*> _components;
-		static constexpr index_t Level = 2u;
-		static constexpr index_t BucketSize = 1 << 12;
-		index_t bucket_of(index_t i) const { return i >> 12; }
+		using config = entity_hbv::config;
+		using flag_t = config::flag_t;
+		static_assert(BucketBits % config::BitsPerLayer == 0u && BucketBits >= config::BitsPerLayer && BucketBits < config::LayerCount * config::BitsPerLayer,
+			"bucket of sparse vector should be a node of hbv");
+		//һͰӦ hbv һڵ(ĬΪڶ,4ʱΪlayer2,4096Ԫ)
+		static constexpr index_t BucketLevel = config::LayerCount - BucketBits / config::BitsPerLayer;
+		static constexpr index_t BucketSize = 1 << BucketBits;
+		static constexpr index_t WordBits = config::BitsPerLayer;
+		static constexpr index_t WordsPerBucket = BucketSize >> WordBits;
+		index_t bucket_of(index_t i) const { return i >> BucketBits; }
 		index_t index_of(index_t i) const { return i & (BucketSize - 1); }
 
+		//Ͱһ,[0] ΪͰİ汾,[1 + w] ΪͰڵ w ڵİ汾
+		using stamp_t = std::atomic<version_t>;
+		using allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+		using stamp_allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<stamp_t>;
+
+		const entity_hbv& _entities;
+		std::vector<T*> _components;
+		std::vector<stamp_t*> _versions;
+		version_t _version = 1u;
+		allocator_t _allocator;
+		stamp_allocator_t _stampAllocator;
+
+		//бʱ߳̿дͬһ汾,ȶдνĻ
+		static void touch(stamp_t& stamp, version_t version) noexcept
+		{
+			if (stamp.load(std::memory_order_relaxed) != version)
+				stamp.store(version, std::memory_order_relaxed);
+		}
+
+		// [e, e + count) ڵͰͽڵİ汾,䲻Ͱ
+		void stamp(index_t e, index_t count = 1u) noexcept
+		{
+			stamp_t* versions = _versions[bucket_of(e)];
+			touch(versions[0], _version);
+			index_t first = index_of(e) >> WordBits;
+			index_t last = (index_of(e) + count - 1u) >> WordBits;
+			for (index_t w = first; w <= last; ++w)
+				touch(versions[1u + w], _version);
+		}
+
+		void fit(index_t bucket)
+		{
+			if (_components.size() <= bucket)
+			{
+				_components.resize(bucket + _components.size(), nullptr);
+				_versions.resize(_components.size(), nullptr);
+			}
+		}
+
+		void make_bucket(T*& data, stamp_t*& versions)
+		{
+			data = std::allocator_traits<allocator_t>::allocate(_allocator, BucketSize);
+			versions = std::allocator_traits<stamp_allocator_t>::allocate(_stampAllocator, 1u + WordsPerBucket);
+			for (index_t i = 0; i < 1u + WordsPerBucket; ++i)
+				new (versions + i) stamp_t(0u);
+		}
+
+		void allocate_bucket(index_t bucket)
+		{
+			make_bucket(_components[bucket], _versions[bucket]);
+		}
+
+		void free_bucket(index_t bucket) noexcept
+		{
+			std::allocator_traits<allocator_t>::deallocate(_allocator, _components[bucket], BucketSize);
+			_components[bucket] = nullptr;
+			std::allocator_traits<stamp_allocator_t>::deallocate(_stampAllocator, _versions[bucket], 1u + WordsPerBucket);
+			_versions[bucket] = nullptr;
+		}
+
 	public:
-		sparse_vector(const common::hbv& entities)
-			: _entities(entities), _components(10u, nullptr) {}
+		//ͰڵԪ
+		static constexpr index_t ChunkSize = BucketSize;
+
+		/*
+		汾 since Ĳ,λĽӿ, filter Ϻ
+		Ͱһ㰴Ͱİ汾ڶ㰴ڵİ汾ü,㲻
+		*/
+		class version_filter
+		{
+			const basic_sparse_vector& _vector;
+			version_t _since;
+
+			bool fresh(index_t bucket) const noexcept
+			{
+				return bucket < _vector._versions.size() && _vector._versions[bucket] != nullptr
+					&& _vector._versions[bucket][0].load(std::memory_order_relaxed) >= _since;
+			}
+
+		public:
+			using config = entity_hbv::config;
+			using flag_t = config::flag_t;
+
+			version_filter(const basic_sparse_vector& vector, version_t since) noexcept : _vector(vector), _since(since) {}
+
+			flag_t layer0() const noexcept
+			{
+				return layer<0>(0);
+			}
+
+			template<index_t N>
+			flag_t layer(index_t id) const noexcept
+			{
+				if constexpr (N == config::LeafLayer)
+					return config::FullNode;
+				else if constexpr (N + 1u == BucketLevel)
+				{
+					flag_t node = config::EmptyNode;
+					for (index_t i = 0; i <= config::NodeMask; ++i)
+						if (fresh((id << config::BitsPerLayer) | i))
+							node |= flag_t(1) << i;
+					return node;
+				}
+				else if constexpr (N + 1u == config::LeafLayer)
+				{
+					//ͰСڵ
+					index_t first = id << (config::BitsPerLayer * 2u);
+					index_t bucket = _vector.bucket_of(first);
+					if (!fresh(bucket))
+						return config::EmptyNode;
+					flag_t node = config::EmptyNode;
+					const stamp_t* versions = _vector._versions[bucket] + 1u + (_vector.index_of(first) >> WordBits);
+					for (index_t w = 0; w <= config::NodeMask; ++w)
+						if (versions[w].load(std::memory_order_relaxed) >= _since)
+							node |= flag_t(1) << w;
+					return node;
+				}
+				else
+					return config::FullNode;
+			}
+
+			flag_t layer(index_t level, index_t id) const noexcept
+			{
+				return common::hbv_detail::dispatch_layer(*this, level, id, std::make_index_sequence<config::LayerCount>());
+			}
+
+			bool contain(index_t id) const noexcept
+			{
+				index_t bucket = _vector.bucket_of(id);
+				return fresh(bucket) && _vector._versions[bucket][1u + (_vector.index_of(id) >> WordBits)].load(std::memory_order_relaxed) >= _since;
+			}
+		};
+
+		basic_sparse_vector(const entity_hbv& entities, const Allocator& allocator = Allocator())
+			: _entities(entities), _components(10u, nullptr), _versions(10u, nullptr), _allocator(allocator), _stampAllocator(allocator) {}
+
+		//Ԫ components ,ֻͷͰ
+		~basic_sparse_vector()
+		{
+			for (index_t i = 0; i < _components.size(); ++i)
+				if (_components[i])
+					free_bucket(i);
+		}
+
+		basic_sparse_vector(const basic_sparse_vector&) = delete;
+		basic_sparse_vector& operator=(const basic_sparse_vector&) = delete;
 
 		T& get(index_t e)
 		{
+			stamp(e);
 			return _components[bucket_of(e)][index_of(e)];
 		}
 
@@ -31,36 +185,59 @@ namespace ecs
 			return _components[bucket_of(e)][index_of(e)];
 		}
 
+		// e ʼͰĩβԪ,дʱζΪд
+		T* data(index_t e)
+		{
+			return data(e, BucketSize - index_of(e));
+		}
+
+		//ֻд [e, e + count) ʱֻһεİ汾( runs/chunks )
+		T* data(index_t e, index_t count)
+		{
+			stamp(e, std::min(count, BucketSize - index_of(e)));
+			return _components[bucket_of(e)] + index_of(e);
+		}
+
+		const T* data(index_t e) const
+		{
+			return _components[bucket_of(e)] + index_of(e);
+		}
+
 		T &create(index_t e, const T& arg)
 		{
 			index_t bucket = bucket_of(e);
-			if (_components.size() <= bucket)
-				_components.resize(bucket + _components.size(), nullptr);
+			fit(bucket);
 			if (_components[bucket] == nullptr)
-				_components[bucket] = (T*)malloc(sizeof(T)*BucketSize);
+				allocate_bucket(bucket);
+			stamp(e);
 			return *(new (_components[bucket] + index_of(e)) T{ arg });
 		}
 
 		void batch_create(index_t begin, index_t end, const T& arg)
 		{
+			if (begin >= end)
+				return;
 			index_t first = bucket_of(begin);
 			index_t last = bucket_of(end - 1);
-			if (_components.size() <= last)
-				_components.resize(last + _components.size(), nullptr);
+			fit(last);
 			for (index_t i = first; i <= last; ++i)
-				if (_entities.layer(Level, i) && !_components[i])
-					_components[i] = (T*)malloc(sizeof(T)*BucketSize);
+				if (_entities.layer(BucketLevel, i) && !_components[i])
+					allocate_bucket(i);
+			for (index_t i = begin; i < end; i = (bucket_of(i) + 1u) << BucketBits)
+				stamp(i, std::min(end - i, BucketSize - index_of(i)));
 			if constexpr(std::is_pod_v<T>)
 			{
 				for (index_t i = first + 1; i < last; ++i)
 					std::fill_n(_components[i], BucketSize, arg);
 				index_t firstIndex = index_of(begin);
+				//end Ͱı߽
+				index_t lastIndex = index_of(end - 1) + 1;
 				if (last > first)
 				{
 					std::fill_n(_components[first] + firstIndex, BucketSize - firstIndex, arg);
-					std::fill_n(_components[last], index_of(end), arg);
+					std::fill_n(_components[last], lastIndex, arg);
 				}
-				else std::fill_n(_components[first] + firstIndex, index_of(end) - firstIndex, arg);
+				else std::fill_n(_components[first] + firstIndex, lastIndex - firstIndex, arg);
 			}
 			else
 			{
@@ -78,8 +255,8 @@ namespace ecs
 			{
 				_components[bucket][index_of(e)].~T();
 			}
-			if (!_entities.layer(Level, bucket) && _components[bucket])
-				free(_components[bucket]);
+			if (!_entities.layer(BucketLevel, bucket) && _components[bucket])
+				free_bucket(bucket);
 		}
 
 		void batch_remove(const and_chbv& remove)
@@ -93,24 +270,83 @@ namespace ecs
 			}
 		}
 
-		void after_batch_remove()
+		//ű old еԪذƵµͰ,µ id ھɵ id,ƺԪضΪд
+		void remap(const entity_hbv& old, const id_remap& table)
 		{
-			common::for_each<Level - 1>(_entities, [this](index_t i)
+			std::vector<T*> fresh(std::max<std::size_t>(_components.size(), 10u), nullptr);
+			std::vector<stamp_t*> versions(fresh.size(), nullptr);
+			common::for_each(old, [this, &fresh, &versions, &table](index_t i)
 			{
-				if (!_entities.layer(Level, i) && _components[i])
-					free(_components[i]);
+				index_t n = table[i];
+				index_t bucket = bucket_of(n);
+				if (fresh[bucket] == nullptr)
+					make_bucket(fresh[bucket], versions[bucket]);
+				T& from = _components[bucket_of(i)][index_of(i)];
+				new (fresh[bucket] + index_of(n)) T{ std::move(from) };
+				if constexpr(!std::is_pod_v<T>)
+					from.~T();
 			});
+			for (index_t i = 0; i < _components.size(); ++i)
+				if (_components[i])
+					free_bucket(i);
+			_components.swap(fresh);
+			_versions.swap(versions);
+			for (index_t i = 0; i < _components.size(); ++i)
+				if (_components[i])
+					stamp(i << BucketBits, BucketSize);
+		}
+
+		//ǰ汾,дͰͽڵ¼ǰ汾
+		version_t version() const noexcept
+		{
+			return _version;
+		}
+
+		//汾(ÿ֡һ),д벢
+		version_t next_version() noexcept
+		{
+			return ++_version;
+		}
+
+		//һдİ汾 since Ĳ,Ͱײڵ
+		version_filter changed_since(version_t since) const noexcept
+		{
+			return { *this, since };
+		}
+
+		//ͷűΪյͰ,Ͱ hbv Ѿûб,ҪͰ
+		void after_batch_remove()
+		{
+			for (index_t i = 0; i < _components.size(); ++i)
+			{
+				if (_components[i] && !_entities.layer(BucketLevel, i))
+					free_bucket(i);
+			}
 		}
 	};
 
+	//Ĭõ sparse_vector
+	template<typename T>
+	class sparse_vector : public basic_sparse_vector<T>
+	{
+	public:
+		using basic_sparse_vector<T>::basic_sparse_vector;
+	};
+
+	/*
+	ָͰС sparse_vector, Component(Transform, sparse_storage<aligned_allocator<Transform>, 6>::type)
+	Ϊ״̬( arena_allocator)ʱ,ͨ components(std::allocator_arg, allocator) 
+	*/
+	template<typename Allocator, common::index_t BucketBits = entity_hbv::config::BitsPerLayer * 2u>
+	struct sparse_storage
+	{
+		template<typename T>
+		using type = basic_sparse_vector<T, Allocator, BucketBits>;
+	};
+
 	DefStorage(sparse_vector)
 	{
 	public:
 		DefConstructor(sparse_vector) : generic(_has) {}
-		void batch_remove(const common::hbv& remove) noexcept
-		{
-			generic::batch_remove(remove);
-			container.after_batch_remove();
-		}
 	};
 }
\ No newline at end of file
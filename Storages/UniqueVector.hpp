@@ -1,5 +1,6 @@
 #pragma once
 #include "SparseVector.hpp"
+#include <unordered_map>
 
 namespace ecs
 {
@@ -11,46 +12,93 @@ namespace ecs
 	/*
 	unique_vector ֻݵΨһָ벢Ϊÿһάһ filter, filter ֮л
 	ӲĽϴʱԴ(mesh)
+	ָضͨ Allocator ,ÿֵ filter Ϊ hbv
+	ֵλĹϣʹʱΪ O(1),filter ΪյĲλбֵ֮
 	*/
-	template<typename T>
-	class unique_vector
+	template<typename T, typename Allocator = std::allocator<T>>
+	class basic_unique_vector
 	{
 		static_assert(std::is_pointer_v<T> || is_shared_ptr<T>{} , "unique vector only work with pointers");
-		std::vector<T> _components;
-		std::vector<common::hbv> _filters;
-		sparse_vector<index_t> _redirector;
+		template<typename U>
+		using allocator_t = typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
+		std::vector<T, allocator_t<T>> _components;
+		std::vector<entity_hbv> _filters;
+		basic_sparse_vector<index_t, allocator_t<index_t>> _redirector;
+		//ֵλ,ֻʹõĲλ
+		std::unordered_map<T, index_t, std::hash<T>, std::equal_to<T>, allocator_t<std::pair<const T, index_t>>> _slots;
+		std::vector<index_t, allocator_t<index_t>> _free;
 		using ref = decltype(*std::declval<T>());
 
+		static std::decay_t<ref>* raw(const T& p) noexcept
+		{
+			if constexpr(is_shared_ptr<T>{})
+				return p.get();
+			else
+				return p;
+		}
+
 		void create_on(index_t e, index_t i) noexcept
 		{
 			auto& filter = _filters[i];
-			if (filter.size() < e)
-				filter.grow_to(e * 3 / 2);
+			if (filter.size() <= e)
+				filter.grow_to(e / 2u + e + 1u);
 			filter.set(e, true);
 			_redirector.create(e, i);
 		}
+
+		//ȡֵڵĲλ,µֵʹÿеĲλ
+		index_t acquire(const T& arg)
+		{
+			auto iter = _slots.find(arg);
+			if (iter != _slots.end())
+				return iter->second;
+			index_t i;
+			if (!_free.empty())
+			{
+				i = _free.back();
+				_free.pop_back();
+				_components[i] = arg;
+			}
+			else
+			{
+				i = index_t(_components.size());
+				_components.emplace_back(arg);
+				_filters.emplace_back();
+			}
+			_slots.emplace(arg, i);
+			return i;
+		}
+
+		//filter Ϊյֵͷ,λб
+		void release(index_t i)
+		{
+			_slots.erase(_components[i]);
+			_components[i] = nullptr;
+			_free.push_back(i);
+		}
 	public:
 		// current filter С,Ϊ 'has' filter
 		int32_t currentFilter;
 
-		unique_vector(const common::hbv& entities)
-			: _redirector(entities), currentFilter(-1) { }
+		basic_unique_vector(const entity_hbv& entities, const Allocator& allocator = Allocator())
+			: _components(allocator_t<T>(allocator)), _redirector(entities, allocator_t<index_t>(allocator)),
+			_slots(allocator_t<std::pair<const T, index_t>>(allocator)), _free(allocator_t<index_t>(allocator)), currentFilter(-1) { }
 
 		//note:  current filter > 0,  e ᱻ
 		const std::decay_t<ref> *get(index_t e) const
 		{
 			if (currentFilter>0)
-				return _components[currentFilter];
+				return raw(_components[currentFilter]);
 			else
-				return _components[_redirector.get(e)];
+				return raw(_components[_redirector.get(e)]);
 		}
 
 		std::decay_t<ref> *get(index_t e)
 		{
 			if (currentFilter>0)
-				return _components[currentFilter];
+				return raw(_components[currentFilter]);
 			else
-				return _components[_redirector.get(e)];
+				return raw(_components[_redirector.get(e)]);
 		}
 
 		index_t unique_size() const
@@ -58,17 +106,26 @@ namespace ecs
 			return _components.size();
 		}
 
+		// i λֵӵ entity,вλֵΪ,filter ҲΪ( grouped )
+		const T& unique_value(index_t i) const
+		{
+			return _components[i];
+		}
+
+		const entity_hbv& unique_filter(index_t i) const
+		{
+			return _filters[i];
+		}
+
 		int32_t find_unique(const T& arg) const
 		{
-			for (index_t i = 0; i < _components.size(); ++i)
-				if (arg == _components[i])
-					return i;
-			return -1;
+			auto iter = _slots.find(arg);
+			return iter != _slots.end() ? int32_t(iter->second) : -1;
 		}
 
-		const common::hbv &filter() const
+		const entity_hbv &filter() const
 		{
-			return _filters[FilterId];
+			return _filters[currentFilter];
 		}
 
 		void batch_create(index_t begin, index_t end, const T& arg)
@@ -82,43 +139,47 @@ namespace ecs
 			_redirector.batch_create(begin + 1, end, prototype);
 		}
 
+		void batch_instantiate(index_t begin, index_t end, index_t proto)
+		{
+			const T prototype = _components[_redirector.get(proto)];
+			batch_create(begin, end, prototype);
+		}
+
 		void instantiate(index_t e, index_t proto)
 		{
-			index_t prototype = _redirector.get(proto);
-			_filters[prototype].set(e, true);
-			_redirector.create(e, prototype);
+			create_on(e, _redirector.get(proto));
 		}
 
 		const T &create(index_t e, const T& arg)
 		{
-			for (index_t i = 0; i < _components.size(); ++i)
-				if (arg == _components[i])
-				{
-					create_on(e, i);
-					return arg;
-				}
-			index_t i = 0;
-			for (; i < _components.size(); ++i)
-				if (nullptr == _components[i]) break;
-			if (i == _components.size())
-			{
-				_components.emplace_back(arg);
-				_filters.emplace_back();
-			}
+			index_t i = acquire(arg);
 			create_on(e, i);
-			return _components.back();
+			return _components[i];
 		}
 
+		//ֻڵɾн filter,вλ filter Ϊ,Ȼ
 		void batch_remove(const and_chbv& remove)
 		{
-			for (int i = 0; i < _filters.size(); ++i)
+			auto root = remove.layer0();
+			for (index_t i = 0; i < _filters.size(); ++i)
 			{
-				_filters[i].merge_sub(remove);
-				if (common::empty(_filters[i]))
-					_components[i] = nullptr;
+				auto& filter = _filters[i];
+				if ((filter.layer0() & root) == 0u)
+					continue;
+				filter.merge_sub(remove);
+				if (common::empty(filter))
+					release(i);
 			}
 		}
 
+		void remap(const entity_hbv& old, const id_remap& table)
+		{
+			for (auto& filter : _filters)
+				if (!common::empty(filter))
+					filter = remapped(filter, table);
+			_redirector.remap(old, table);
+		}
+
 		void remove(index_t e)
 		{
 			index_t id = _redirector.get(e);
@@ -126,14 +187,30 @@ namespace ecs
 			filter.set(e, false);
 			_redirector.remove(e);
 			if (common::empty(filter))
-				_components[id] = nullptr;
+				release(id);
 		}
 	};
 
+	//Ĭõ unique_vector
+	template<typename T>
+	class unique_vector : public basic_unique_vector<T>
+	{
+	public:
+		using basic_unique_vector<T>::basic_unique_vector;
+	};
+
+	//ָ unique_vector,ֵл filter Ҫͨ container
+	template<typename Allocator>
+	struct unique_storage
+	{
+		template<typename T>
+		using type = basic_unique_vector<T, Allocator>;
+	};
+
 	DefStorage(unique_vector)
 	{
 	public:
-		DefConstructor(unique_vector) : generic(has()) {}
+		DefConstructor(unique_vector) : generic(_has) {}
 		index_t unique_size() const noexcept
 		{
 			return container.unique_size();
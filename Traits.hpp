@@ -9,13 +9,27 @@ namespace ecs
 	һcomponentԶ
 	Ϊ(component,)
 	*/
-#define Component(ctype, cstorage, ...) \
-	ecs::components<ctype, cstorage, __VA_ARGS__>; \
+#define Component(ctype, ...) \
+	ecs::components<ctype, __VA_ARGS__>; \
 	template<> \
 	struct hbv_map_trait<ctype> \
 	{ \
 		using type = ctype; \
-		using hbv_map = ecs::components<type, cstorage, __VA_ARGS__>; \
+		using hbv_map = ecs::components<type, __VA_ARGS__>; \
+	}
+
+	template<typename T>
+	struct soa_layout;
+
+	/*
+	 component ֶβִ(soa_vector)ʱֶб
+	Ϊ(component,Աָ...), SoaLayout(Transform, &Transform::x, &Transform::y);
+	*/
+#define SoaLayout(ctype, ...) \
+	template<> \
+	struct soa_layout<ctype> \
+	{ \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
 	}
 
 	template<>
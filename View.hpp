@@ -2,15 +2,56 @@
 #include "Entities.hpp"
 #include "Components.hpp"
 #include "Traits.hpp"
-#include <execution>
+#include "JobPool.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
 
 
 namespace ecs
 {
+	namespace view_detail
+	{
+		//Ԫڵ storage,ûעΪ component ʱΪ void
+		template<typename T, bool = common::is_complete<hbv_map_trait<T>>::value>
+		struct storage_of { using type = void; };
+		template<typename T>
+		struct storage_of<T, true> { using type = typename hbv_map_trait<T>::hbv_map::template storage<T>; };
+
+		//storage ͨ pointer<U> Զݵָ( soa_vector ֶηֿ),ĬΪ U*
+		template<typename S, typename U, typename = void>
+		struct storage_pointer { using type = U*; };
+		template<typename S, typename U>
+		struct storage_pointer<S, U, std::void_t<typename S::template pointer<U>>> { using type = typename S::template pointer<U>; };
+	}
+
+	/*
+	һײڵӦһ component,ڰڵ(chunks )
+	data ָڵһλӦԪ,mask ĵ i λʾ data[i] Ч
+	ʺ SIMD ,chunk<const T> ӦԴ,chunk<T> ռжӦԴ
+	*/
+	template<typename T>
+	struct chunk
+	{
+		using flag_t = entity_hbv::config::flag_t;
+		using pointer = typename view_detail::storage_pointer<typename view_detail::storage_of<std::remove_const_t<T>>::type, T>::type;
+		static constexpr index_t Size = 1u << entity_hbv::config::BitsPerLayer;
+
+		pointer data;
+		flag_t mask;
+
+		decltype(auto) operator[](index_t i) const noexcept { return data[i]; }
+		bool contain(index_t i) const noexcept { return (mask >> i) & 1; }
+	};
+
 	template<typename T>
 	struct is_atomic_arg : std::true_type {};
 	template<typename T>
+	struct is_atomic_arg<span<T>> : std::is_const<T> {};
+	template<typename T>
+	struct is_atomic_arg<chunk<T>> : std::is_const<T> {};
+	template<typename T>
 	struct is_atomic_arg<std::reference_wrapper<T>> : std::false_type {};
 	template<typename T>
 	struct is_atomic_arg<T&> : std::false_type {};
@@ -27,10 +68,10 @@ namespace ecs
 		{
 			using nonstrict_type = std::conditional_t
 			<
-				contain_v
+				common::contain_v
 				<
 					T,
-					rewrap_t<typelist, C>
+					common::rewrap_t<common::typelist, C>
 				>,
 				T,
 				std::remove_reference_t<T> const&
@@ -41,6 +82,37 @@ namespace ecs
 		template<typename T>
 		using is_hbv_map_element = common::is_complete<hbv_map_trait<T>>;
 
+		//span/chunk ӦԪ
+		template<typename T>
+		struct element_of { using type = T; };
+		template<typename T>
+		struct element_of<span<T>> { using type = std::remove_const_t<T>; };
+		template<typename T>
+		struct element_of<chunk<T>> { using type = std::remove_const_t<T>; };
+		template<typename T>
+		using element_of_t = typename element_of<T>::type;
+
+		template<typename T>
+		struct is_span : std::false_type {};
+		template<typename T>
+		struct is_span<span<T>> : std::true_type {};
+
+		template<typename T>
+		struct is_chunk : std::false_type {};
+		template<typename T>
+		struct is_chunk<chunk<T>> : std::true_type {};
+
+		template<typename T>
+		using is_contiguous_arg = std::disjunction<is_span<T>, is_chunk<T>>;
+
+		//
+		enum class iteration
+		{
+			element, //ÿ entity һ
+			run,     //ÿһ
+			word     //ÿǿյײڵһ
+		};
+
 		template<typename... Ts>
 		struct compound_filter_helper
 		{
@@ -54,20 +126,176 @@ namespace ecs
 			template<typename S>
 			__forceinline static decltype(auto) call(S &components) noexcept
 			{
-				return common::and(pick<Ts>(components)...);
+				return common::and_(pick<Ts>(components)...);
+			}
+
+			template<typename S>
+			__forceinline static decltype(auto) call_any(S &components) noexcept
+			{
+				return common::or_(pick<Ts>(components)...);
+			}
+		};
+
+		/*
+		filter :ųӵһָ component  entity
+		 for_view<seq>(view, job, without<Frozen>{})
+		 andnot ʵ,ԭ filter ķֲṹ,ų component Ҫ view (Ϊ const)
+		*/
+		template<typename... Ts>
+		struct without
+		{
+			template<typename S, typename T>
+			__forceinline auto apply(S &components, T&& filter) const noexcept
+			{
+				return common::andnot(std::forward<T>(filter), compound_filter_helper<Ts...>::call_any(components));
+			}
+		};
+
+		/*
+		filter :ֻ T ϴζȡ֮仯 entity(Ҫ T 仯׷)
+		 for_view<seq>(view, job, changed<Location>{ cursor }),cursor  watch_changes ȡ,ÿ system һ
+		ÿεöǰˮλ,T Ҫ view (Ϊ const)
+		*/
+		template<typename T>
+		struct changed
+		{
+			change_cursor cursor;
+			//ϲı仯, for_view ڼЧ
+			mutable entity_hbv collected;
+
+			explicit changed(change_cursor c) noexcept : cursor(c) {}
+
+			template<typename S, typename F>
+			__forceinline auto apply(S &components, F&& filter) const
+			{
+				using type = typename hbv_map_trait<T>::hbv_map;
+				const auto& storage = nonstrict_get<type&>(components);
+				storage.collect_changes(cursor, collected);
+				//仯֮ѱɾ
+				return common::and_(std::forward<F>(filter), collected, storage.filter());
+			}
+		};
+
+		/*
+		filter :ֻһ֡ T  entity(Ҫ T ¼¼ÿ֡ flip_events)
+		 for_view<seq>(view, job, added<Mesh>{}),T Ҫ view (Ϊ const)
+		*/
+		template<typename T>
+		struct added
+		{
+			template<typename S, typename F>
+			__forceinline auto apply(S &components, F&& filter) const noexcept
+			{
+				using type = typename hbv_map_trait<T>::hbv_map;
+				return common::and_(std::forward<F>(filter), nonstrict_get<type&>(components).added());
+			}
+		};
+
+		/*
+		filter :ֻһ֡ɾ T  entity,T ѱɾ, job  T Ϊ
+		 for_view<seq>(view, job, removed<Mesh>{}),T Ҫ view (Ϊ const)
+		*/
+		template<typename T>
+		struct removed
+		{
+			template<typename S, typename F>
+			__forceinline auto apply(S &components, F&& filter) const noexcept
+			{
+				using type = typename hbv_map_trait<T>::hbv_map;
+				return common::and_(std::forward<F>(filter), nonstrict_get<type&>(components).removed());
+			}
+		};
+
+		/*
+		filter :ֻ T ڰ汾 since ֮()дͰײڵе entity,Ҫ T  storage ¼汾
+		 for_view<seq>(view, job, changed_since<Transform>{ last }),Ϊײڵ,ڵδд entity Ҳᱻ
+		߶ȡǰ version(),´Ϊ since,©д(ͬһ汾ڶȡ֮дᱻٴα)
+		*/
+		template<typename T>
+		struct changed_since
+		{
+			version_t since;
+
+			explicit changed_since(version_t v) noexcept : since(v) {}
+
+			template<typename S, typename F>
+			__forceinline auto apply(S &components, F&& filter) const noexcept
+			{
+				using type = typename hbv_map_trait<T>::hbv_map;
+				return common::and_(std::forward<F>(filter), nonstrict_get<type&>(components).changed_since(since));
+			}
+		};
+
+		//Կдķʽ job  component(T&span<T>chunk<T>),Ϊ void
+		template<typename T>
+		struct mutable_element { using type = void; };
+		template<typename T>
+		struct mutable_element<T&> { using type = std::conditional_t<std::is_const_v<T> || !is_hbv_map_element<T>{}, void, T>; };
+		template<typename T>
+		struct mutable_element<span<T>> { using type = std::conditional_t<std::is_const_v<T>, void, T>; };
+		template<typename T>
+		struct mutable_element<chunk<T>> { using type = std::conditional_t<std::is_const_v<T>, void, T>; };
+
+		//, filter Ϊд component ı仯
+		template<typename... Ts>
+		struct change_helper
+		{
+			template<typename U>
+			using tracking_trait = decltype(std::declval<U&>().tracking_changes());
+
+			template<typename T, typename S, typename F>
+			static void mark_one(S &components, const F& filter)
+			{
+				if constexpr(!std::is_void_v<T>)
+				{
+					using type = typename hbv_map_trait<T>::hbv_map;
+					if constexpr(common::is_detected<tracking_trait, type>::value)
+					{
+						auto& storage = nonstrict_get<type&>(components);
+						if (storage.tracking_changes())
+							storage.mark_changed(filter);
+					}
+				}
+			}
+
+			template<typename S, typename F>
+			static void mark(S &components, const F& filter)
+			{
+				(mark_one<typename mutable_element<Ts>::type>(components, filter), ...);
 			}
 		};
 
+		template<typename S, typename T>
+		__forceinline auto modify_filter(S&, T&& filter) noexcept
+		{
+			return std::forward<T>(filter);
+		}
+
+		template<typename S, typename T, typename M, typename... Ms>
+		__forceinline auto modify_filter(S& components, T&& filter, const M& modifier, const Ms&... modifiers) noexcept
+		{
+			return modify_filter(components, modifier.apply(components, std::forward<T>(filter)), modifiers...);
+		}
+
+		//Ts Ϊ job Ĳ,ֻз const õ component Կдķʽȡ(д get д汾)
 		template<typename... Ts>
 		struct iterator_helper
 		{
-			template<typename T, typename S>
+			template<typename A, typename S>
 			__forceinline static decltype(auto) pick(S &components, index_t id) noexcept
 			{
+				using T = std::decay_t<A>;
 				if constexpr(is_hbv_map_element<T>{})
 				{
 					using type = typename hbv_map_trait<T>::hbv_map;
-					return nonstrict_get<type&>(components).get(id);
+					if constexpr(std::is_void_v<typename mutable_element<A>::type>)
+						return std::as_const(nonstrict_get<type&>(components)).get(id);
+					else
+						return nonstrict_get<type&>(components).get(id);
+				}
+				else if constexpr(std::is_same_v<T, index_t>)
+				{
+					return id;
 				}
 				else
 				{
@@ -82,9 +310,80 @@ namespace ecs
 			}
 		};
 
+		//Ϊ span/chunk ȡŵԪ
+		template<typename... Ts>
+		struct contiguous_helper
+		{
+			template<typename T>
+			using chunk_size_trait = decltype(T::ChunkSize);
+
+			template<typename T>
+			static constexpr index_t chunk_size_of() noexcept
+			{
+				if constexpr(is_contiguous_arg<T>{})
+				{
+					using element = element_of_t<T>;
+					using container = typename hbv_map_trait<element>::hbv_map::template storage<element>;
+					static_assert(common::is_detected<chunk_size_trait, container>::value, "storage is not contiguous, span is not supported!");
+					return container::ChunkSize;
+				}
+				else
+				{
+					return ~index_t(0u);
+				}
+			}
+
+			// span/chunk ֤
+			static constexpr index_t ChunkSize = std::min({ ~index_t(0u), chunk_size_of<Ts>()... });
+
+			template<typename T, typename S, typename M>
+			__forceinline static decltype(auto) pick(S &components, index_t begin, index_t size, M mask) noexcept
+			{
+				if constexpr(is_contiguous_arg<T>{})
+				{
+					using type = typename hbv_map_trait<element_of_t<T>>::hbv_map;
+					//Ҫ const ޶ȡ,ֻĲд汾,дֻ½ job (chunk Ϊһڵ)
+					if constexpr(std::is_void_v<typename mutable_element<T>::type>)
+					{
+						auto data = std::as_const(nonstrict_get<type&>(components)).data(begin);
+						if constexpr(is_span<T>{})
+							return T{ data, size };
+						else
+							return T{ data, mask };
+					}
+					else if constexpr(is_span<T>{})
+						return T{ nonstrict_get<type&>(components).data(begin, size), size };
+					else
+						return T{ nonstrict_get<type&>(components).data(begin, index_t(1u) << entity_hbv::config::BitsPerLayer), mask };
+				}
+				else if constexpr(std::is_same_v<T, index_t>)
+				{
+					return begin;
+				}
+				else
+				{
+					return nonstrict_get<T&>(components);
+				}
+			}
+
+			template<typename F, typename S>
+			__forceinline static void call(S &components, index_t begin, index_t end, F&& f) noexcept
+			{
+				f(pick<Ts>(components, begin, end - begin, 0)...);
+			}
+
+			template<typename F, typename S, typename M>
+			__forceinline static void call_masked(S &components, index_t base, M mask, F&& f) noexcept
+			{
+				f(pick<Ts>(components, base, 0u, mask)...);
+			}
+		};
+
 		/*򵥵Ա*/
 		struct seq
 		{
+			static constexpr iteration mode = iteration::element;
+
 			template<typename T, typename F>
 			__forceinline static void for_each(const T& vec, const F& f) noexcept
 			{
@@ -92,37 +391,257 @@ namespace ecs
 			}
 		};
 
-		/*stdĲб*/
-		struct par
+		/*
+		ڹȡ̳߳صĲб
+		 filter  [first, last]  hbv ,ÿ Grain ±(뵽 Grain),Ҫ±껺
+		зʱ hbv ϲжǷΪ,յֱӶΪ,ز֮߳ȡƽ,߳Ҳִ
+		ע,ɱСʱӦ Grain(ĬΪ sparse_vector һͰ)
+		*/
+		template<index_t Grain = (1u << 12)>
+		struct basic_par
 		{
-			/*
-			̱߳ǰ,̱߳һ㲢ִк
-			ע,ɱСʱ,ַήٶ(ڴĽϴ
-			*/
+			static_assert(Grain > 0u, "grain of parallel iteration must be positive");
+			static constexpr iteration mode = iteration::element;
+
 			template<typename T, typename F>
 			__forceinline static void for_each(const T& vec, const F& f) noexcept
 			{
-				std::vector<index_t> indicesBuffer;
-				indicesBuffer.reserve(512u);
-				common::for_each<2>(vec, [&indicesBuffer](index_t id)
+				int32_t first = common::first(vec);
+				if (first == -1)
+					return;
+				index_t last = index_t(common::last(vec)) + 1u;
+				common::job_pool::instance().parallel_for(index_t(first), last, Grain, [&vec, &f](index_t begin, index_t end)
 				{
-					indicesBuffer.push_back(id);
+					common::for_each(vec, begin, end, f);
+				}, [&vec](index_t begin, index_t end)
+				{
+					return common::first(vec, begin, end) == -1;
 				});
-				using namespace common::hbv_detail;
-				std::for_each(std::execution::par, std::begin(indicesBuffer), std::end(indicesBuffer), [&f, &vec](index_t id)
+			}
+		};
+
+		using par = basic_par<>;
+
+		enum class auto_par_choice : uint8_t
+		{
+			serial,   //̱߳
+			parallel, //ϸȲ, Grain з,ȡƽ⸺
+			chunked   //Ȳ,ÿ߳Լ,зֺ͵ȵĿС
+		};
+
+		//auto_par ״ֻ̬,ͨ basic_auto_par::stats<Job>() ȡ
+		struct auto_par_stats
+		{
+			double serialNs;        // entity Ĵкʱ()
+			double overheadNs[2];   //ϸ/ȲеĶ⿪()
+			uint32_t decisions;     //пʱľߴ
+			uint32_t chosen[3];     //ÿִзʽִеĴ
+			auto_par_choice last;   //һεִзʽ
+		};
+
+		/*
+		auto_par Ϊÿ system ¼ľߺͺʱ,֡ҵ
+		ʱ"ÿƵ entity",ֵƫԤͲ໥
+		еĿʵʺʱ֮,ͬ͸ز
+		ֲеĳʼͬ,˭ʵ,ļ֡ƫĳһ
+		*/
+		struct auto_par_state
+		{
+			std::atomic<double> serialNs;
+			std::atomic<double> overheadNs[2];
+			std::atomic<uint32_t> decisions{ 0u };
+			std::atomic<uint32_t> chosen[3] = { 0u, 0u, 0u };
+			std::atomic<auto_par_choice> last{ auto_par_choice::serial };
+
+			explicit auto_par_state(double cost) noexcept
+				: serialNs(cost), overheadNs{ 10000.0, 10000.0 } {}
+
+			auto_par_stats snapshot() const noexcept
+			{
+				constexpr auto relaxed = std::memory_order_relaxed;
+				return { serialNs.load(relaxed), { overheadNs[0].load(relaxed), overheadNs[1].load(relaxed) }, decisions.load(relaxed),
+					{ chosen[0].load(relaxed), chosen[1].load(relaxed), chosen[2].load(relaxed) }, last.load(relaxed) };
+			}
+
+			//Ԥĺʱ()
+			double predict(auto_par_choice choice, index_t estimated, index_t concurrency) const noexcept
+			{
+				double serial = serialNs.load(std::memory_order_relaxed) * estimated;
+				if (choice == auto_par_choice::serial)
+					return serial;
+				return serial / concurrency + overheadNs[index_t(choice) - 1u].load(std::memory_order_relaxed);
+			}
+
+			//ʵʺʱ,ָƽ(1/8)
+			void record(auto_par_choice choice, index_t estimated, index_t concurrency, double ns) noexcept
+			{
+				constexpr double alpha = 1.0 / 8.0;
+				auto blend = [alpha](std::atomic<double>& value, double sample)
 				{
-					flag_t node = vec.layer3(id);
-					index_t prefix = id << BitsPerLayer;
-					do
+					value.store(value.load(std::memory_order_relaxed) * (1.0 - alpha) + sample * alpha, std::memory_order_relaxed);
+				};
+				chosen[index_t(choice)].fetch_add(1u, std::memory_order_relaxed);
+				last.store(choice, std::memory_order_relaxed);
+				if (choice == auto_par_choice::serial)
+					blend(serialNs, ns / std::max(estimated, 1u));
+				else
+				{
+					double ideal = serialNs.load(std::memory_order_relaxed) * estimated / concurrency;
+					//вܿ,˵еԤƫ(Cost )
+					if (ns < ideal)
+						blend(serialNs, ns * concurrency / std::max(estimated, 1u));
+					blend(overheadNs[index_t(choice) - 1u], std::max(ns - ideal, 0.0));
+				}
+			}
+		};
+
+		/*
+		Զѡлеı
+		 hbv ϲٹ filter (άʱΪ׼ȷֵ), Cost( entity Ԥʱ,)
+		Ԥ⴮СϸȲкʹȲеĺʱѡС,ִкʵʺʱԤ
+		Ԥӽ()ʱÿ 16 γһδŵѡ,ʼ Cost ׼ȷʱһִзʽ
+		ÿ system(job )ж״̬,ͨ stats<Job>() ȡ
+		*/
+		template<index_t Cost = 1u, index_t Grain = (1u << 12)>
+		struct basic_auto_par
+		{
+			static_assert(Cost > 0u, "cost of auto parallel iteration must be positive");
+			static constexpr iteration mode = iteration::element;
+
+		private:
+			template<typename Key>
+			static auto_par_state& state() noexcept
+			{
+				static auto_par_state s{ double(Cost) };
+				return s;
+			}
+
+		public:
+			//for_view ״̬ job 
+			template<typename Job>
+			static auto_par_stats stats() noexcept
+			{
+				return state<std::decay_t<Job>>().snapshot();
+			}
+
+			template<typename T, typename F>
+			static void for_each(const T& vec, const F& f) noexcept
+			{
+				for_each_job<F>(vec, f);
+			}
+
+			template<typename Job, typename T, typename F>
+			static void for_each_job(const T& vec, const F& f) noexcept
+			{
+				using clock = std::chrono::steady_clock;
+				auto& pool = common::job_pool::instance();
+				auto_par_state& s = state<Job>();
+				index_t estimated = common::estimate(vec);
+				if (estimated == 0u)
+					return;
+				index_t concurrency = pool.concurrency();
+				auto choice = auto_par_choice::serial;
+				if (concurrency > 1u)
+				{
+					double predicted[3];
+					for (index_t i = 0; i < 3u; ++i)
+						predicted[i] = s.predict(auto_par_choice(i), estimated, concurrency);
+					index_t best = 0u, second = 1u;
+					for (index_t i = 1; i < 3u; ++i)
 					{
-						index_t low = lowbit_pos(node);
-						node &= ~(flag_t(1) << low);
-						f(prefix | low);
-					} while (node);
-				});
+						if (predicted[i] < predicted[best])
+							second = best, best = i;
+						else if (i != second && predicted[i] < predicted[second])
+							second = i;
+					}
+					choice = auto_par_choice(best);
+					if (s.decisions.fetch_add(1u, std::memory_order_relaxed) % 16u == 15u && predicted[second] < predicted[best] * 2.0)
+						choice = auto_par_choice(second);
+				}
+				auto start = clock::now();
+				if (choice == auto_par_choice::serial)
+					common::for_each(vec, f);
+				else
+				{
+					index_t first = index_t(common::first(vec));
+					index_t last = index_t(common::last(vec)) + 1u;
+					index_t grain = Grain;
+					if (choice == auto_par_choice::chunked)
+					{
+						//ÿ߳Լ,뵽 Grain
+						index_t pieces = (last - first) / (concurrency * 2u);
+						grain = std::max(Grain, (pieces + Grain - 1u) / Grain * Grain);
+					}
+					pool.parallel_for(first, last, grain, [&vec, &f](index_t begin, index_t end)
+					{
+						common::for_each(vec, begin, end, f);
+					}, [&vec](index_t begin, index_t end)
+					{
+						return common::first(vec, begin, end) == -1;
+					});
+				}
+				double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+				s.record(choice, estimated, concurrency, ns);
 			}
 		};
 
+		using auto_par = basic_auto_par<>;
+
+		/*
+		Ա,job  component Ϊ span, job(span<Location>, span<const Velocity>)
+		 storage ߽( sparse_vector Ͱ)п,job ڲдյĿѭ
+		ʺ batch_create Ĵ entity,index_t Ϊ
+		*/
+		struct runs
+		{
+			static constexpr iteration mode = iteration::run;
+
+			template<typename T, typename F>
+			__forceinline static void for_each(const T& vec, const F& f) noexcept
+			{
+				common::for_each_run(vec, f);
+			}
+		};
+
+		/*
+		ײڵԱ,job  component Ϊ chunk, job(chunk<Location>, chunk<const Velocity>)
+		ÿǿսڵһ,chunk ṩڵӦ 64 Ԫغ,job дһδԪ
+		index_t Ϊڵһλ±
+		*/
+		struct chunks
+		{
+			static constexpr iteration mode = iteration::word;
+
+			template<typename T, typename F>
+			__forceinline static void for_each(const T& vec, const F& f) noexcept
+			{
+				common::for_each_word(vec, f);
+			}
+		};
+
+		/*
+		 unique_vector ֵ,ÿԹֵһ prologue,ٰ Inner Աӵֵ entity
+		 for_view<grouped<MeshPtr>>(view, [](const MeshPtr& mesh) { bind(mesh); }, [](const Transform& t) { submit(t); })
+		T  components Ҫ view (Ϊ const),storage Ҫṩ unique_size/unique_value/unique_filter( unique_vector)
+		ÿ filter Ϊֵ filter  filter()Ľ,ڵ㲻ֱཻ
+		Parallel ʱ̳߳ϲ,prologue Ҳڹ߳ϵ,԰ Inner 
+		*/
+		template<typename T, typename Inner = seq, bool Parallel = false>
+		struct grouped
+		{
+			using group_type = T;
+			using inner = Inner;
+			static constexpr bool parallel = Parallel;
+		};
+
+		template<typename T, typename Inner = seq>
+		using par_grouped = grouped<T, Inner, true>;
+
+		template<typename S>
+		using group_trait = typename S::group_type;
+		template<typename S>
+		using is_grouped = common::is_detected<group_trait, S>;
+
 		//˴ħ
 		template<typename F>
 		struct implict_view_helper
@@ -135,6 +654,10 @@ namespace ecs
 				using type = std::conditional_t<is_hbv_map_element<T>{}, typename hbv_map_trait<T>::hbv_map, T> ;
 			};
 			template<typename T>
+			struct upgrade_helper<span<T>> : upgrade_helper<std::remove_const_t<T>> {};
+			template<typename T>
+			struct upgrade_helper<chunk<T>> : upgrade_helper<std::remove_const_t<T>> {};
+			template<typename T>
 			using upgrade_helper_t = typename upgrade_helper<std::decay_t<T>>::type;
 			template<typename T>
 			using upgrade = std::conditional_t<is_atomic_arg<T>::value, std::add_const_t<upgrade_helper_t<T>>, upgrade_helper_t<T>>;
@@ -155,10 +678,62 @@ namespace ecs
 				1. const ,share ӦԴ
 				2. ,borrow ӦԴ
 				3. ֵ,share ӦԴ
+				4. span<const T>/chunk<const T>,share ӦԴ,span<T>/chunk<T>,borrow ӦԴ
 		*/
 		template<typename F>
 		using implict_view = typename implict_view_helper<F>::view;
 
+		template<typename S>
+		using job_keyed_trait = decltype(&S::template stats<void>);
+
+		//Ե filter ϵ job,arguments Ϊ job Ĳ
+		template<typename iterator_strategy, typename arguments, typename S, typename T, typename F>
+		void for_filter(S& view, const T& filter, F& job)
+		{
+			using namespace common;
+			using requests = map_t<std::decay_t, arguments>;
+			if constexpr (iterator_strategy::mode == iteration::run)
+			{
+				static_assert(size<filter_t<is_hbv_map_element, requests>> == 0, "component should be passed as span in ranged strategy!");
+				static_assert(size<filter_t<is_chunk, requests>> == 0, "chunk is only supported by chunked strategy!");
+				using helper = rewrap_t<contiguous_helper, requests>;
+				iterator_strategy::for_each(filter, [&view, &job](index_t begin, index_t end)
+				{
+					// storage ߽紦п
+					while (begin < end)
+					{
+						index_t stop = std::min(end, (begin / helper::ChunkSize + 1u) * helper::ChunkSize);
+						helper::call(view, begin, stop, job);
+						begin = stop;
+					}
+				});
+			}
+			else if constexpr (iterator_strategy::mode == iteration::word)
+			{
+				static_assert(size<filter_t<is_hbv_map_element, requests>> == 0, "component should be passed as chunk in chunked strategy!");
+				static_assert(size<filter_t<is_span, requests>> == 0, "span is only supported by ranged strategy!");
+				using helper = rewrap_t<contiguous_helper, requests>;
+				static_assert(helper::ChunkSize % (1u << entity_hbv::config::BitsPerLayer) == 0, "storage is not contiguous in a whole node!");
+				iterator_strategy::for_each(filter, [&view, &job](index_t base, auto mask)
+				{
+					helper::call_masked(view, base, mask, job);
+				});
+			}
+			else
+			{
+				static_assert(size<filter_t<is_contiguous_arg, requests>> == 0, "span/chunk is only supported by ranged/chunked strategy!");
+				auto visit = [&view, &job](index_t i)
+				{
+					rewrap_t<iterator_helper, arguments>::call(view, i, job);
+				};
+				// job ¼״̬Ĳ( auto_par)
+				if constexpr (is_detected<job_keyed_trait, iterator_strategy>::value)
+					iterator_strategy::template for_each_job<std::decay_t<F>>(filter, visit);
+				else
+					iterator_strategy::for_each(filter, visit);
+			}
+		}
+
 		/*
 		 view ִһ߼(ͨģָ),߼㺯: void(request_list...)
 		 some_job(some_component&, fuck&)
@@ -169,35 +744,99 @@ namespace ecs
 				2. filter ,ֱӵһ
 			   ʱ job ĲԶ
 		,job ͨ index_t ֱӻȡǰ,ͨ remove ¼
+		Ϊ runs ʱ,component Ϊ span,ÿһ
+		Ϊ chunks ʱ,component Ϊ chunk,ÿǿյײڵһ
+		filter ( withoutchangedchanged_sinceaddedremoved)ᰴ˳ component ϳ filter 
+		˱仯׷ٵ component Կдķʽʱ, filter Ϊ仯( filter ϲ)
 		*/
-		template<typename iterator_strategy, typename S, typename F>
-		void for_view(S view, F&& job)
+		template<typename iterator_strategy, typename S, typename F, typename... Ms>
+		std::enable_if_t<!is_grouped<iterator_strategy>::value> for_view(S view, F&& job, const Ms&... modifiers)
 		{
 			using namespace common;
 			using function_info = generic_function_trait<std::decay_t<F>>;
 			using requests = map_t<std::decay_t, typename function_info::argument_type>;
-			using elements = filter_t<is_hbv_map_element, requests>;
+			using elements = filter_t<is_hbv_map_element, map_t<element_of_t, requests>>;
 			if constexpr (size<elements> == 0)
 			{
 				static_assert(!contain_v<index_t, requests>, "index is not making sense without filter!");
-				rewrap_t<iterator_helper, requests>::call(view, 0, job);
+				static_assert(sizeof...(Ms) == 0, "filter modifier is not making sense without filter!");
+				rewrap_t<iterator_helper, typename function_info::argument_type>::call(view, 0, job);
 			}
 			else
 			{
-				const auto filter = rewrap_t<compound_filter_helper, elements>::call(view);
+				const auto filter = modify_filter(view, rewrap_t<compound_filter_helper, elements>::call(view), modifiers...);
 				//ͨ iterator policy ִ
-				iterator_strategy::for_each(filter, [&view, &job](index_t i)
+				for_filter<iterator_strategy, typename function_info::argument_type>(view, filter, job);
+				rewrap_t<change_helper, typename function_info::argument_type>::mark(view, filter);
+			}
+		}
+
+		/*
+		(grouped ),prologue 㺯: void(const T&),job  for_view ͬ
+		 component ǲ filter,job Բ
+		*/
+		template<typename iterator_strategy, typename S, typename G, typename F, typename... Ms>
+		std::enable_if_t<is_grouped<iterator_strategy>::value> for_view(S view, G&& prologue, F&& job, const Ms&... modifiers)
+		{
+			using namespace common;
+			using group_t = typename iterator_strategy::group_type;
+			using inner = typename iterator_strategy::inner;
+			using function_info = generic_function_trait<std::decay_t<F>>;
+			using requests = map_t<std::decay_t, typename function_info::argument_type>;
+			using elements = union_t<filter_t<is_hbv_map_element, map_t<element_of_t, requests>>, typelist<group_t>>;
+			static_assert(!is_grouped<inner>::value, "groups can't be nested!");
+			//ֻһ( changed ȡ߱仯)
+			const auto filter = modify_filter(view, rewrap_t<compound_filter_helper, elements>::call(view), modifiers...);
+			const auto root = filter.layer0();
+			const auto& groups = nonstrict_get<typename hbv_map_trait<group_t>::hbv_map&>(view).container;
+			auto visit = [&view, &job, &prologue, &filter, &groups, root](index_t i)
+			{
+				const entity_hbv& members = groups.unique_filter(i);
+				if ((members.layer0() & root) == 0u)
+					return;
+				//ϵϲܶʵ,ȷ entity ٵ prologue
+				const auto group = common::and_(members, filter);
+				if (common::first(group) == -1)
+					return;
+				prologue(groups.unique_value(i));
+				for_filter<inner, typename function_info::argument_type>(view, group, job);
+			};
+			index_t count = index_t(groups.unique_size());
+			if constexpr (iterator_strategy::parallel)
+			{
+				common::job_pool::instance().parallel_for(0u, count, 1u, [&visit](index_t begin, index_t end)
 				{
-					rewrap_t<iterator_helper, requests>::call(view, i, job);
+					for (index_t i = begin; i < end; ++i)
+						visit(i);
 				});
 			}
+			else
+			{
+				for (index_t i = 0; i < count; ++i)
+					visit(i);
+			}
+			rewrap_t<change_helper, typename function_info::argument_type>::mark(view, filter);
 		}
 	}
 
 	using view_detail::implict_view;
 	using view_detail::for_view;
 	using view_detail::par;
+	using view_detail::basic_par;
+	using view_detail::auto_par;
+	using view_detail::basic_auto_par;
+	using view_detail::auto_par_choice;
+	using view_detail::auto_par_stats;
 	using view_detail::seq;
+	using view_detail::runs;
+	using view_detail::chunks;
+	using view_detail::grouped;
+	using view_detail::par_grouped;
+	using view_detail::without;
+	using view_detail::changed;
+	using view_detail::changed_since;
+	using view_detail::added;
+	using view_detail::removed;
 
 	template<typename... Ts>
 	auto as_view(Ts&... args)
@@ -0,0 +1,132 @@
+﻿#pragma once
+#include "Entities.hpp"
+#include "Components.hpp"
+#include "JobPool.hpp"
+#include "Storages/Allocators.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace ecs
+{
+	/*
+	world 持有 entities 和所有登记的 components,负责把 entity 的死亡传递到每个 components
+	components 可以由 world 创建并持有(emplace),也可以由外部持有并登记(attach)
+	world 可以提供一个内存池(arena),从中分配的 components 随 world 一起整体释放
+	*/
+	class world final
+	{
+		//最先声明,在所有 components 之后析构
+		std::unique_ptr<arena_resource> _arena;
+		entities _entities;
+		std::vector<std::unique_ptr<components_abstract>> _owned;
+		std::vector<components_abstract*> _storages;
+
+	public:
+		world() = default;
+		world(const world&) = delete;
+		world& operator=(const world&) = delete;
+
+		entities& ents() noexcept
+		{
+			return _entities;
+		}
+
+		const entities& ents() const noexcept
+		{
+			return _entities;
+		}
+
+		//创建一个由 world 持有的 components 并登记
+		template<typename Cs, typename... Ts>
+		Cs& emplace(Ts&&... args)
+		{
+			auto storage = std::make_unique<Cs>(std::forward<Ts>(args)...);
+			Cs& result = *storage;
+			_owned.push_back(std::move(storage));
+			_storages.push_back(&result);
+			return result;
+		}
+
+		//world 的内存池,第一次使用时创建
+		std::pmr::memory_resource* arena()
+		{
+			if (!_arena)
+				_arena = std::make_unique<arena_resource>();
+			return _arena.get();
+		}
+
+		//创建一个由 world 持有、从内存池分配的 components,storage 需要以 arena_allocator 配置(如 sparse_storage<arena_allocator<std::byte>>::type)
+		template<typename Cs>
+		Cs& emplace_in_arena()
+		{
+			return emplace<Cs>(std::allocator_arg, arena_allocator<std::byte>(arena()));
+		}
+
+		//登记一个外部持有的 components,需要在 world 之前析构时先 detach
+		void attach(components_abstract& storage)
+		{
+			if (std::find(_storages.begin(), _storages.end(), &storage) == _storages.end())
+				_storages.push_back(&storage);
+		}
+
+		void detach(components_abstract& storage)
+		{
+			_storages.erase(std::remove(_storages.begin(), _storages.end(), &storage), _storages.end());
+		}
+
+		index_t storage_count() const noexcept
+		{
+			return index_t(_storages.size());
+		}
+
+		/*
+		使被 kill 的 entity 正式死亡,并删除它们在所有 components 中的 component
+		根节点与 killed 没有交集的 components 直接跳过,其余的 components 之间互不相关,在线程池上并行 batch_remove
+		*/
+		void die()
+		{
+			const entity_hbv& killed = _entities.killed();
+			auto root = killed.layer0();
+			if (root != 0u)
+			{
+				std::vector<components_abstract*> targets;
+				targets.reserve(_storages.size());
+				for (auto* storage : _storages)
+					if ((storage->members().layer0() & root) != 0u)
+						targets.push_back(storage);
+				common::job_pool::instance().parallel_for(0u, index_t(targets.size()), 1u, [&targets, &killed](index_t begin, index_t end)
+				{
+					for (index_t i = begin; i < end; ++i)
+						targets[i]->batch_remove(killed);
+				});
+			}
+			_entities.die();
+		}
+
+		/*
+		把存活的 entity 重新编号为连续的 id,并同步重新编号所有 components,返回旧 id 到新 id 的编号表
+		先执行 die,挂在不存活的 entity 上的 component 会被删除;各 components 之间并行处理
+		外部保存的 entity 句柄需要通过 ents().get(table[old.id]) 重新取得,旧句柄都会失效
+		*/
+		id_remap compact()
+		{
+			die();
+			const entity_hbv& alive = _entities.filter();
+			for (auto* storage : _storages)
+			{
+				entity_hbv stray(storage->members().size());
+				stray.merge_add(common::andnot(storage->members(), alive));
+				if (!common::empty(stray))
+					storage->batch_remove(stray);
+			}
+			id_remap table = _entities.compact();
+			common::job_pool::instance().parallel_for(0u, index_t(_storages.size()), 1u, [this, &table](index_t begin, index_t end)
+			{
+				for (index_t i = begin; i < end; ++i)
+					_storages[i]->remap(table);
+			});
+			return table;
+		}
+	};
+}